@@ -0,0 +1,208 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+/******************************************************\
+ * Allocation Counting                                *
+\******************************************************/
+
+// Replacing the global operator new lets us count every allocation made through new (including by
+// the standard containers) without touching the code being measured.
+//     The aligned overloads are left alone, as nothing we benchmark over-aligns its allocations.
+static std::atomic<ui64> g_allocationCount(0);
+static std::atomic<ui64> g_allocatedBytes(0);
+
+void* operator new(size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) throw std::bad_alloc();
+
+    return ptr;
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    return std::malloc(size == 0 ? 1 : size);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+ui64 spbench::Allocations::count() {
+    return g_allocationCount.load(std::memory_order_relaxed);
+}
+
+ui64 spbench::Allocations::bytes() {
+    return g_allocatedBytes.load(std::memory_order_relaxed);
+}
+
+/******************************************************\
+ * Benchmark Runner                                   *
+\******************************************************/
+
+/**
+ * @brief Writes the given string to the given file as a JSON string, escaping as needed.
+ */
+static void writeJsonString(FILE* file, const std::string& str) {
+    fputc('"', file);
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if (static_cast<ui8>(c) < 0x20) {
+            fprintf(file, "\\u%04x", static_cast<ui32>(c));
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+spbench::BenchmarkRunner::BenchmarkRunner() :
+    m_samples(DEFAULT_BENCHMARK_SAMPLES)
+{
+    /* Empty */
+}
+
+void spbench::BenchmarkRunner::run(const std::string& name, const char* unit, size_t items, const Routine& setup, const Routine& body) {
+    if (!isSelected(name)) return;
+
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up caches, and let anything the body grows reach its steady-state size.
+    setup();
+    body();
+
+    std::vector<f64> times(m_samples);
+    ui64 allocations    = 0;
+    ui64 allocatedBytes = 0;
+    for (ui32 sample = 0; sample < m_samples; ++sample) {
+        setup();
+
+        ui64 countBefore = Allocations::count();
+        ui64 bytesBefore = Allocations::bytes();
+
+        auto start = Clock::now();
+        body();
+        auto stop  = Clock::now();
+
+        allocations    += Allocations::count() - countBefore;
+        allocatedBytes += Allocations::bytes() - bytesBefore;
+
+        times[sample] = static_cast<f64>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    }
+
+    // Report per item, so that differently sized runs of the same benchmark compare directly.
+    f64 perItem = 1.0 / static_cast<f64>(std::max(items, static_cast<size_t>(1)));
+    for (auto& time : times) {
+        time *= perItem;
+    }
+    std::sort(times.begin(), times.end());
+
+    f64 total = 0.0;
+    for (auto time : times) {
+        total += time;
+    }
+
+    BenchmarkResult result;
+    result.name            = name;
+    result.unit            = unit;
+    result.items           = items;
+    result.samples         = m_samples;
+    result.skipped         = false;
+    result.minNsPerItem    = times.empty() ? 0.0 : times.front();
+    result.medianNsPerItem = times.empty() ? 0.0 : times[times.size() / 2];
+    result.meanNsPerItem   = times.empty() ? 0.0 : total / static_cast<f64>(times.size());
+    result.allocations     = m_samples == 0 ? 0.0 : static_cast<f64>(allocations)    / static_cast<f64>(m_samples);
+    result.allocatedBytes  = m_samples == 0 ? 0.0 : static_cast<f64>(allocatedBytes) / static_cast<f64>(m_samples);
+
+    m_results.push_back(result);
+}
+
+void spbench::BenchmarkRunner::skip(const std::string& name, const char* unit) {
+    if (!isSelected(name)) return;
+
+    BenchmarkResult result = {};
+    result.name    = name;
+    result.unit    = unit;
+    result.skipped = true;
+
+    m_results.push_back(result);
+}
+
+bool spbench::BenchmarkRunner::isSelected(const std::string& name) const {
+    return m_filter.empty() || name.find(m_filter) != std::string::npos;
+}
+
+bool spbench::BenchmarkRunner::writeJson(const char* filepath) const {
+    FILE* file = stdout;
+    if (filepath != nullptr) {
+        file = fopen(filepath, "w");
+        if (file == nullptr) return false;
+    }
+
+    fprintf(file, "{\n    \"samples\": %u,\n    \"benchmarks\": [\n", m_samples);
+    for (size_t i = 0; i < m_results.size(); ++i) {
+        const BenchmarkResult& result = m_results[i];
+
+        fprintf(file, "        {\n            \"name\": ");
+        writeJsonString(file, result.name);
+        fprintf(file, ",\n            \"unit\": ");
+        writeJsonString(file, result.unit);
+
+        if (result.skipped) {
+            fprintf(file, ",\n            \"skipped\": true\n        }");
+        } else {
+            fprintf(file, ",\n            \"items\": %zu", result.items);
+            fprintf(file, ",\n            \"min_ns_per_item\": %.3f",    result.minNsPerItem);
+            fprintf(file, ",\n            \"median_ns_per_item\": %.3f", result.medianNsPerItem);
+            fprintf(file, ",\n            \"mean_ns_per_item\": %.3f",   result.meanNsPerItem);
+            fprintf(file, ",\n            \"allocations\": %.2f",        result.allocations);
+            fprintf(file, ",\n            \"allocated_bytes\": %.2f\n        }", result.allocatedBytes);
+        }
+
+        fprintf(file, i + 1 < m_results.size() ? ",\n" : "\n");
+    }
+    fprintf(file, "    ]\n}\n");
+
+    bool success = ferror(file) == 0;
+    if (file != stdout) fclose(file);
+
+    return success;
+}
+
+void spbench::BenchmarkRunner::printSummary() const {
+    fprintf(stderr, "%-64s %8s %14s %14s %12s\n", "benchmark", "per", "median ns", "min ns", "allocs");
+    for (auto& result : m_results) {
+        if (result.skipped) {
+            fprintf(stderr, "%-64s %8s %14s\n", result.name.c_str(), result.unit.c_str(), "skipped");
+            continue;
+        }
+
+        fprintf(stderr, "%-64s %8s %14.2f %14.2f %12.2f\n", result.name.c_str(), result.unit.c_str(),
+                    result.medianNsPerItem, result.minNsPerItem, result.allocations);
+    }
+}
@@ -0,0 +1,147 @@
+/**
+ * @file Benchmark.h
+ * @brief Provides a small harness for timing benchmarks, counting their allocations and reporting the results as JSON.
+ */
+
+#pragma once
+
+#if !defined(SP_Bench_Benchmark_h__)
+#define SP_Bench_Benchmark_h__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace bench {
+        // The number of timed samples taken of each benchmark, the median of which is reported.
+        const ui32 DEFAULT_BENCHMARK_SAMPLES = 15;
+
+        /**
+         * @brief Provides counts of the allocations made through the global operator new,
+         * which the benchmark harness replaces for the purpose.
+         */
+        namespace Allocations {
+            ui64 count();
+            ui64 bytes();
+        }
+
+        /**
+         * @brief The results of a benchmark.
+         *
+         * Times are given per item - e.g. per sprite or per glyph - so that benchmarks
+         * run at different sizes may be compared directly. Allocations are given per
+         * sample, i.e. per run of the benchmark's body.
+         */
+        struct BenchmarkResult {
+            std::string name;
+            std::string unit;
+            size_t      items;
+            ui32        samples;
+            bool        skipped;
+            f64         minNsPerItem;
+            f64         medianNsPerItem;
+            f64         meanNsPerItem;
+            f64         allocations;
+            f64         allocatedBytes;
+        };
+
+        /**
+         * @brief Provides the running of benchmarks and the collation of their results.
+         *
+         * Each benchmark is run once to warm up, and then for the number of samples given,
+         * each sample timed separately. Only the body of a benchmark is timed and has its
+         * allocations counted - its setup, run before every sample, is not - so a body that
+         * consumes its input can have it restored each time.
+         */
+        class BenchmarkRunner {
+        public:
+            using Routine = std::function<void()>;
+
+            BenchmarkRunner();
+
+            /**
+             * @brief Sets the number of timed samples taken of each benchmark run after.
+             */
+            void setSamples(ui32 samples) { m_samples = samples; }
+
+            /**
+             * @brief Sets a filter on which benchmarks are run - only those whose name
+             * contains the filter are. An empty filter runs every benchmark.
+             */
+            void setFilter(std::string filter) { m_filter = std::move(filter); }
+
+            /**
+             * @brief Runs a benchmark, recording its results.
+             *
+             * @param name The name of the benchmark.
+             * @param unit The kind of item the benchmark processes, e.g. "sprite".
+             * @param items The number of items processed by each run of the body.
+             * @param setup Run before each run of the body, untimed.
+             * @param body The work to time.
+             */
+            void run(const std::string& name, const char* unit, size_t items, const Routine& setup, const Routine& body);
+            /**
+             * @brief Runs a benchmark with no setup, recording its results.
+             *
+             * @param name The name of the benchmark.
+             * @param unit The kind of item the benchmark processes, e.g. "sprite".
+             * @param items The number of items processed by each run of the body.
+             * @param body The work to time.
+             */
+            void run(const std::string& name, const char* unit, size_t items, const Routine& body) {
+                run(name, unit, items, [](){}, body);
+            }
+            /**
+             * @brief Records a benchmark as skipped, e.g. if what it needs is unavailable.
+             *
+             * @param name The name of the benchmark.
+             * @param unit The kind of item the benchmark would have processed.
+             */
+            void skip(const std::string& name, const char* unit);
+
+            /**
+             * @brief Determines if the named benchmark passes the filter.
+             */
+            bool isSelected(const std::string& name) const;
+
+            const std::vector<BenchmarkResult>& getResults() const { return m_results; }
+
+            /**
+             * @brief Writes the results as JSON, as a single object holding an array of
+             * results under "benchmarks".
+             *
+             * @param filepath The filepath to write to, or nullptr to write to stdout.
+             *
+             * @return True if the results were written, false otherwise.
+             */
+            bool writeJson(const char* filepath) const;
+            /**
+             * @brief Prints a human-readable table of the results to stderr.
+             */
+            void printSummary() const;
+        protected:
+            ui32                         m_samples;
+            std::string                  m_filter;
+            std::vector<BenchmarkResult> m_results;
+        };
+
+        /**
+         * @brief Stops the compiler from optimising away the computation of the given value.
+         */
+        template <typename Type>
+        inline void doNotOptimise(const Type& value) {
+#if defined(__GNUC__) || defined(__clang__)
+            asm volatile("" : : "r,m"(value) : "memory");
+#else
+            static const void* volatile sink;
+            sink = &value;
+#endif
+        }
+    }
+}
+namespace spbench = SecretProject::bench;
+
+#endif // !defined(SP_Bench_Benchmark_h__)
@@ -0,0 +1,500 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+
+#include <random>
+
+#include "debug/Profiler.h"
+#include "graphics/Clipping.hpp"
+#include "graphics/Font.h"
+#include "graphics/SoftwareRenderDevice.h"
+#include "graphics/SpriteBatcher.h"
+#include "io/ImageIO.h"
+
+#include "graphics/StringDrawers.inl"
+
+// Every benchmark draws from random number generators seeded with this, so that each run measures the same work.
+#define BENCHMARK_SEED 0x5EC12E7
+
+// The dimensions of the frame rendered with the software render device.
+#define SOFTWARE_FRAME_WIDTH  640
+#define SOFTWARE_FRAME_HEIGHT 360
+
+// The number of distinct textures sprites are drawn with, which determines how many batches they form.
+#define BENCHMARK_TEXTURES 16
+
+static const char* LOREM_IPSUM = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat. Duis aute irure dolor in reprehenderit in voluptate velit esse cillum dolore eu fugiat nulla pariatur. Excepteur sint occaecat cupidatat non proident, sunt in culpa qui officia deserunt mollit anim id est laborum. ";
+
+/**
+ * @brief Exposes the stages of a sprite batcher's end to the benchmarks, so each can be timed alone.
+ */
+class BenchSpriteBatcher : public spg::SpriteBatcher {
+public:
+    void sort(spg::SpriteSortMode sortMode) {
+        sortSprites(sortMode, m_sprites, m_spritePtrs);
+    }
+
+    void batch(spg::SpriteSortMode sortMode) {
+        m_sortMode = sortMode;
+        generateBatches();
+    }
+};
+
+/**
+ * @brief The properties of a sprite to be drawn, generated up front so that generating them isn't timed.
+ */
+struct SpriteParams {
+    GLuint  texture;
+    f32v2   position;
+    f32v2   size;
+    colour4 colour;
+    f32     depth;
+};
+
+/**
+ * @brief Generates the properties of count sprites scattered over the software frame, a quarter
+ * of them translucent, with textures and depths chosen at random.
+ */
+static std::vector<SpriteParams> generateSpriteParams(size_t count, const std::vector<GLuint>& textures) {
+    std::mt19937 rng(BENCHMARK_SEED);
+    std::uniform_real_distribution<f32> x(-32.0f, static_cast<f32>(SOFTWARE_FRAME_WIDTH));
+    std::uniform_real_distribution<f32> y(-32.0f, static_cast<f32>(SOFTWARE_FRAME_HEIGHT));
+    std::uniform_real_distribution<f32> extent(4.0f, 32.0f);
+    std::uniform_real_distribution<f32> depth(0.0f, 1.0f);
+    std::uniform_int_distribution<size_t> texture(0, textures.size() - 1);
+    std::uniform_int_distribution<ui32> channel(0, 255);
+
+    std::vector<SpriteParams> params(count);
+    for (auto& param : params) {
+        param.texture  = textures[texture(rng)];
+        param.position = f32v2(x(rng), y(rng));
+        param.size     = f32v2(extent(rng), extent(rng));
+        param.colour   = colour4(static_cast<ui8>(channel(rng)), static_cast<ui8>(channel(rng)),
+                                    static_cast<ui8>(channel(rng)), channel(rng) < 64 ? 128 : 255);
+        param.depth    = depth(rng);
+    }
+
+    return params;
+}
+
+/**
+ * @brief Draws the given sprites to the given sprite batcher.
+ */
+static void drawSprites(spg::SpriteBatcher& batcher, const std::vector<SpriteParams>& params) {
+    for (auto& param : params) {
+        batcher.draw(param.texture, param.position, param.size, param.colour, param.colour,
+                        spg::Gradient::NONE, param.depth);
+    }
+}
+
+/**
+ * @brief Determines the number of glyphs drawn for the given UTF-8 string - i.e. those that aren't spaces.
+ */
+static size_t countGlyphs(const std::string& str) {
+    // Continuation bytes are part of the codepoint before them.
+    return static_cast<size_t>(std::count_if(str.begin(), str.end(), [](char c) {
+        return c != ' ' && (static_cast<ui8>(c) & 0xC0) != 0x80;
+    }));
+}
+
+/**
+ * @brief Reads the value of an option from the command line, if it was given.
+ */
+static const char* getOption(int argc, char* argv[], const char* option, const char* fallback) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], option) == 0) return argv[i + 1];
+    }
+    return fallback;
+}
+
+// Usage: SECRET_PROJECT_bench [--json FILE] [--samples N] [--filter NAME] [--font FILE] [--png FILE] [--trace FILE]
+//     Results are written as JSON to the given file, or otherwise to stdout, with a summary to stderr. Font
+//     generation needs an OpenGL context, and is skipped if one can't be made (e.g. on a machine without a GPU).
+//     In builds with profiling, the most recent profile events are written as a Chrome trace if asked.
+int main(int argc, char* argv[]) {
+    const char* jsonPath = getOption(argc, argv, "--json",    nullptr);
+    const char* samples  = getOption(argc, argv, "--samples", nullptr);
+    const char* filter   = getOption(argc, argv, "--filter",  "");
+    const char* fontPath = getOption(argc, argv, "--font",    "fonts/Orbitron-Bold.ttf");
+    const char* pngPath  = getOption(argc, argv, "--png",     "bench.png");
+    const char* trace    = getOption(argc, argv, "--trace",   nullptr);
+
+    if (trace != nullptr) spdebug::Profiler::init();
+
+    spbench::BenchmarkRunner runner;
+    if (samples != nullptr) runner.setSamples(static_cast<ui32>(std::strtoul(samples, nullptr, 10)));
+    runner.setFilter(filter);
+
+    /***************************************************\
+     * Try to get an OpenGL context, for fonts.        *
+    \***************************************************/
+
+    SDL_Window*   window  = nullptr;
+    SDL_GLContext context = nullptr;
+    bool haveFonts = false;
+    if (SDL_Init(SDL_INIT_VIDEO) == 0 && TTF_Init() == 0) {
+        window = SDL_CreateWindow("SECRET_PROJECT_bench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                    SOFTWARE_FRAME_WIDTH, SOFTWARE_FRAME_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+        if (window != nullptr) context = SDL_GL_CreateContext(window);
+
+        haveFonts = context != nullptr && glewInit() == GLEW_OK;
+    }
+
+    // Make sure the font can actually be generated, else we would only be timing the failure to open it.
+    if (haveFonts) {
+        spg::Font probe;
+        probe.init(fontPath);
+        haveFonts = probe.generate(12);
+        probe.dispose();
+    }
+
+    /***************************************************\
+     * Set up a sprite batcher rendering in software.  *
+    \***************************************************/
+
+    spg::SoftwareRenderDevice device;
+    device.init(ui32v2(SOFTWARE_FRAME_WIDTH, SOFTWARE_FRAME_HEIGHT));
+
+    BenchSpriteBatcher batcher;
+    batcher.init(nullptr, &device);
+
+    // Textures the sprites are drawn with - half of them opaque, so that sorting by opacity has something to split.
+    std::vector<GLuint> textures;
+    for (ui32 t = 0; t < BENCHMARK_TEXTURES; ++t) {
+        std::vector<colour4> texels(16 * 16, colour4(255, 255, 255, t % 2 == 0 ? 255 : 192));
+
+        GLuint texture = device.createTexture(ui32v2(16), texels.data());
+        batcher.setTextureOpaque(texture, t % 2 == 0);
+        textures.push_back(texture);
+    }
+
+    const spg::SpriteSortMode sortModes[] = {
+        spg::SpriteSortMode::BACK_TO_FRONT,
+        spg::SpriteSortMode::FRONT_TO_BACK,
+        spg::SpriteSortMode::TEXTURE,
+        spg::SpriteSortMode::TEXTURE_THEN_DEPTH,
+        spg::SpriteSortMode::OPAQUE_THEN_TRANSLUCENT
+    };
+    const char* sortModeNames[] = {
+        "BACK_TO_FRONT",
+        "FRONT_TO_BACK",
+        "TEXTURE",
+        "TEXTURE_THEN_DEPTH",
+        "OPAQUE_THEN_TRANSLUCENT"
+    };
+
+    /***************************************************\
+     * Sprite micro-benchmarks.                        *
+    \***************************************************/
+
+    for (size_t count : { static_cast<size_t>(1000), static_cast<size_t>(100000) }) {
+        std::vector<SpriteParams> params = generateSpriteParams(count, textures);
+        std::string suffix = "/" + std::to_string(count);
+
+        runner.run("SpriteBatcher::draw" + suffix, "sprite", count,
+            [&]() { batcher.begin(); },
+            [&]() { drawSprites(batcher, params); }
+        );
+
+        batcher.begin();
+        drawSprites(batcher, params);
+
+        for (size_t m = 0; m < sizeof(sortModes) / sizeof(sortModes[0]); ++m) {
+            spg::SpriteSortMode sortMode = sortModes[m];
+
+            runner.run("SpriteBatcher::sortSprites/" + std::string(sortModeNames[m]) + suffix, "sprite", count,
+                [&]() { batcher.sort(sortMode); }
+            );
+            runner.run("SpriteBatcher::generateBatches/" + std::string(sortModeNames[m]) + suffix, "sprite", count,
+                [&]() { batcher.sort(sortMode); },
+                [&]() { batcher.batch(sortMode); }
+            );
+        }
+
+        // Build the same sprites as quads directly, without any sorting or batching.
+        std::vector<spg::Sprite> sprites(count);
+        for (size_t i = 0; i < count; ++i) {
+            sprites[i] = spg::Sprite{
+                &spg::buildQuad, params[i].texture, params[i].position, params[i].size, params[i].depth,
+                f32v4(0.0f, 0.0f, 1.0f, 1.0f), params[i].colour, params[i].colour, spg::Gradient::NONE, spg::NO_CLIP
+            };
+        }
+        std::vector<spg::SpriteVertex> vertices(count * 4);
+        runner.run("buildQuad" + suffix, "sprite", count,
+            [&]() {
+                for (size_t i = 0; i < count; ++i) {
+                    spg::buildQuad(&sprites[i], &vertices[i * 4]);
+                }
+                spbench::doNotOptimise(vertices.data());
+            }
+        );
+
+        // Clip the sprites against a rect covering the middle of the frame, such that some are kept whole, some
+        // clipped and some dropped. Clipping is done in place, so the streams are restored before every run.
+        f32v4 clipRect(SOFTWARE_FRAME_WIDTH / 4.0f, SOFTWARE_FRAME_HEIGHT / 4.0f,
+                            SOFTWARE_FRAME_WIDTH / 2.0f, SOFTWARE_FRAME_HEIGHT / 2.0f);
+
+        std::vector<f32> pristine(count * 8), streams(count * 8);
+        for (size_t i = 0; i < count; ++i) {
+            pristine[count * 0 + i] = params[i].position.x;
+            pristine[count * 1 + i] = params[i].position.y;
+            pristine[count * 2 + i] = params[i].size.x;
+            pristine[count * 3 + i] = params[i].size.y;
+            pristine[count * 4 + i] = 0.0f;
+            pristine[count * 5 + i] = 0.0f;
+            pristine[count * 6 + i] = 1.0f;
+            pristine[count * 7 + i] = 1.0f;
+        }
+        spg::ClipStreams objects = {
+            &streams[count * 0], &streams[count * 1], &streams[count * 2], &streams[count * 3],
+            &streams[count * 4], &streams[count * 5], &streams[count * 6], &streams[count * 7]
+        };
+        std::vector<ui8> flags(count);
+
+        runner.run("clipManyScalar" + suffix, "sprite", count,
+            [&]() { streams = pristine; },
+            [&]() { spbench::doNotOptimise(spg::clipManyScalar(clipRect, objects, flags.data(), 0, count)); }
+        );
+        // Named for the width of the path built, as that depends on the instruction sets targeted (see SIMD_AVX2).
+        runner.run("clipMany/x" + std::to_string(spg::CLIP_MANY_LANES) + suffix, "sprite", count,
+            [&]() { streams = pristine; },
+            [&]() { spbench::doNotOptimise(spg::clipMany(clipRect, objects, flags.data(), count)); }
+        );
+    }
+
+    /***************************************************\
+     * Sprite macro-benchmarks.                        *
+    \***************************************************/
+
+    for (size_t count : { static_cast<size_t>(1000), static_cast<size_t>(100000) }) {
+        std::vector<SpriteParams> params = generateSpriteParams(count, textures);
+        std::string suffix = "/" + std::to_string(count);
+
+        for (size_t m = 0; m < sizeof(sortModes) / sizeof(sortModes[0]); ++m) {
+            spg::SpriteSortMode sortMode = sortModes[m];
+
+            runner.run("SpriteBatcher::end/" + std::string(sortModeNames[m]) + suffix, "sprite", count,
+                [&]() {
+                    batcher.begin();
+                    drawSprites(batcher, params);
+                },
+                [&]() { batcher.end(sortMode); }
+            );
+        }
+    }
+
+    // Rasterising in software is far slower than building sprites, so we keep to a modest frame.
+    {
+        const size_t count = 2000;
+        std::vector<SpriteParams> params = generateSpriteParams(count, textures);
+
+        batcher.begin();
+        drawSprites(batcher, params);
+        batcher.end(spg::SpriteSortMode::OPAQUE_THEN_TRANSLUCENT);
+
+        runner.run("SoftwareRenderDevice::render/" + std::to_string(count), "sprite", count,
+            [&]() { device.clear(); },
+            [&]() { batcher.render(f32v2(SOFTWARE_FRAME_WIDTH, SOFTWARE_FRAME_HEIGHT)); }
+        );
+    }
+
+    /***************************************************\
+     * Text benchmarks.                                *
+    \***************************************************/
+
+    // Strings are drawn with a font of made-up glyphs, so that what is measured doesn't depend on the font
+    // available or on a GPU. Glyphs vary in width much as those of a proportional font would.
+    spg::Font syntheticFont;
+    syntheticFont.init("", spg::FIRST_PRINTABLE_CHAR, spg::LAST_PRINTABLE_CHAR);
+
+    // As well as ASCII, there is a page of CJK ideographs, so that text outside ASCII can be measured too.
+    const char32_t FIRST_SYNTHETIC_IDEOGRAPH = 0x4E00;
+    const char32_t LAST_SYNTHETIC_IDEOGRAPH  = 0x4EFF;
+
+    spg::GlyphTable glyphs;
+    for (char32_t c = spg::FIRST_PRINTABLE_CHAR; c <= spg::LAST_PRINTABLE_CHAR; ++c) {
+        f32 width = 6.0f + static_cast<f32>((c * 7) % 9);
+        glyphs.insert(c) = spg::Glyph{ c, f32v4(0.0f, 0.0f, 0.05f, 0.05f), f32v2(width, 20.0f), true, width, 0.0f };
+    }
+    for (char32_t c = FIRST_SYNTHETIC_IDEOGRAPH; c <= LAST_SYNTHETIC_IDEOGRAPH; ++c) {
+        glyphs.insert(c) = spg::Glyph{ c, f32v4(0.0f, 0.0f, 0.05f, 0.05f), f32v2(20.0f, 20.0f), true, 20.0f, 0.0f };
+    }
+
+    // Likewise some pairs of glyphs are kerned, so that layout pays for looking kerning up.
+    std::vector<i16> kerning(spg::KERNING_TABLE_WIDTH * spg::KERNING_TABLE_WIDTH, 0);
+    for (size_t i = 0; i < kerning.size(); i += 7) {
+        kerning[i] = -1;
+    }
+
+    std::vector<colour4> fontTexels(256 * 256, colour4(255, 255, 255, 255));
+    spg::FontInstance syntheticInstance = {
+        device.createTexture(ui32v2(256), fontTexels.data()), 20, &glyphs, &syntheticFont, ui32v2(256), kerning.data()
+    };
+
+    for (size_t repeats : { static_cast<size_t>(1), static_cast<size_t>(32) }) {
+        std::string text;
+        for (size_t r = 0; r < repeats; ++r) {
+            text += LOREM_IPSUM;
+        }
+        size_t glyphCount = countGlyphs(text);
+        std::string suffix = "/" + std::to_string(glyphCount);
+
+        spg::StringSizing sizing = { spg::StringSizingKind::SCALED, { f32v2(1.0f, 1.0f) } };
+
+        spg::StringComponents components = {
+            { text.c_str(), spg::StringDrawProperties{ syntheticInstance, sizing, colour4(0, 0, 0, 255) } }
+        };
+        // Much narrower than the text, such that wrapping strings are wrapped into many lines, and tall
+        // enough that only some of those are clipped.
+        f32v4 rect(0.0f, 0.0f, 400.0f, 20.0f * static_cast<f32>(repeats) * 12.0f);
+
+        // Laying out afresh and drawing, as is done for every string drawn to a draw context.
+        spg::TextLayout layout;
+        auto layoutAndDraw = [&](spg::WordWrap wrap) {
+            spg::layoutStringComponents(&batcher.getFrameArena(), components.data(), components.size(), rect,
+                                            spg::TextAlign::TOP_LEFT, wrap, layout);
+            spg::drawTextLayout(&batcher, layout, f32v2(0.0f), 0.0f);
+        };
+
+        runner.run("drawNoWrapString" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { layoutAndDraw(spg::WordWrap::NONE); }
+        );
+        runner.run("drawQuickWrapString" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { layoutAndDraw(spg::WordWrap::QUICK); }
+        );
+        runner.run("drawGreedyWrapString" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { layoutAndDraw(spg::WordWrap::GREEDY); }
+        );
+        runner.run("drawMinRagWrapString" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { layoutAndDraw(spg::WordWrap::MINIMUM_RAGGEDNESS); }
+        );
+
+        // Laying out alone, to compare the cost of choosing breaks greedily against minimising raggedness.
+        auto layoutOnly = [&](spg::WordWrap wrap) {
+            spg::layoutStringComponents(&batcher.getFrameArena(), components.data(), components.size(), rect,
+                                            spg::TextAlign::TOP_LEFT, wrap, layout);
+        };
+
+        runner.run("layoutGreedyWrapString" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { layoutOnly(spg::WordWrap::GREEDY); }
+        );
+        runner.run("layoutMinRagWrapString" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { layoutOnly(spg::WordWrap::MINIMUM_RAGGEDNESS); }
+        );
+
+        // Drawing the same string each frame, such that after the warm-up its layout is always cached.
+        runner.run("drawString/cached" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { batcher.drawString(components, rect, spg::TextAlign::TOP_LEFT, spg::WordWrap::GREEDY); }
+        );
+    }
+
+    // Text of three-byte UTF-8 sequences, in runs of a few ideographs split by spaces so that it can be wrapped.
+    {
+        std::string text;
+        for (char32_t i = 0; i < 4096; ++i) {
+            char32_t c = FIRST_SYNTHETIC_IDEOGRAPH + (i * 37) % (LAST_SYNTHETIC_IDEOGRAPH - FIRST_SYNTHETIC_IDEOGRAPH + 1);
+
+            text += static_cast<char>(0xE0 | (c >> 12));
+            text += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (c & 0x3F));
+
+            if (i % 3 == 2) text += ' ';
+        }
+        size_t glyphCount = countGlyphs(text);
+        std::string suffix = "/utf8/" + std::to_string(glyphCount);
+
+        spg::StringSizing sizing = { spg::StringSizingKind::SCALED, { f32v2(1.0f, 1.0f) } };
+
+        spg::StringComponents components = {
+            { text.c_str(), spg::StringDrawProperties{ syntheticInstance, sizing, colour4(0, 0, 0, 255) } }
+        };
+        f32v4 rect(0.0f, 0.0f, 400.0f, 20.0f * 256.0f);
+
+        spg::TextLayout layout;
+        auto layoutAndDraw = [&](spg::WordWrap wrap) {
+            spg::layoutStringComponents(&batcher.getFrameArena(), components.data(), components.size(), rect,
+                                            spg::TextAlign::TOP_LEFT, wrap, layout);
+            spg::drawTextLayout(&batcher, layout, f32v2(0.0f), 0.0f);
+        };
+
+        runner.run("drawNoWrapString" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { layoutAndDraw(spg::WordWrap::NONE); }
+        );
+        runner.run("drawGreedyWrapString" + suffix, "glyph", glyphCount,
+            [&]() { batcher.begin(); },
+            [&]() { layoutAndDraw(spg::WordWrap::GREEDY); }
+        );
+    }
+
+    // Generating a font renders each of its glyphs and packs them into a texture.
+    const size_t fontGlyphs = static_cast<size_t>(spg::LAST_PRINTABLE_CHAR - spg::FIRST_PRINTABLE_CHAR + 1);
+    for (spg::FontSize size : { 12, 24, 48, 96 }) {
+        std::string name = "Font::generate/" + std::to_string(size);
+
+        if (!haveFonts) {
+            runner.skip(name, "glyph");
+            continue;
+        }
+
+        spg::Font font;
+        runner.run(name, "glyph", fontGlyphs,
+            [&]() {
+                font.dispose();
+                font.init(fontPath);
+            },
+            [&]() { font.generate(size); }
+        );
+        font.dispose();
+    }
+
+    /***************************************************\
+     * Image benchmarks.                               *
+    \***************************************************/
+
+    for (ui32 size : { 64u, 256u, 1024u }) {
+        std::vector<colour4> pixels(static_cast<size_t>(size) * size);
+
+        std::mt19937 rng(BENCHMARK_SEED);
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            // Mostly smooth, with some noise, so that compression has something like real work to do.
+            ui8 noise = static_cast<ui8>(rng() & 0x0F);
+            pixels[i] = colour4(static_cast<ui8>(i % size), static_cast<ui8>(i / size), noise, 255);
+        }
+
+        runner.run("Image::PNG::save/" + std::to_string(size) + "x" + std::to_string(size), "pixel", pixels.size(),
+            [&]() {
+                spio::Image::PNG::save(pngPath, pixels.data(), ui32v2(size), spio::Image::PixelFormat::RGBA_UI8);
+            }
+        );
+    }
+    std::remove(pngPath);
+
+    /***************************************************\
+     * Report and clean up.                            *
+    \***************************************************/
+
+    runner.printSummary();
+    bool written = runner.writeJson(jsonPath);
+
+    if (trace != nullptr) {
+        written &= spdebug::Profiler::dumpChromeTrace(trace);
+        spdebug::Profiler::dispose();
+    }
+
+    batcher.dispose();
+    device.dispose();
+
+    if (context != nullptr) SDL_GL_DeleteContext(context);
+    if (window  != nullptr) SDL_DestroyWindow(window);
+    TTF_Quit();
+    SDL_Quit();
+
+    return written ? 0 : 1;
+}
@@ -30,6 +30,7 @@ ECHO "        CMake flags:\n"
 ECHO "            --release           | -r       ---   Compile in release mode.\n"
 ECHO "            --debug             | -d       ---   Compile in debug mode.\n"
 ECHO "            --x64               | -64      ---   Compile for x64 architecture.\n"
+ECHO "            --profiling         | -p       ---   Compile in profiling zones.\n"
 ECHO "        Make flags:\n"
 ECHO "            --verbose           | -v       ---   Run make with verbose set on.\n"
 ECHO "\n"
@@ -51,6 +52,10 @@ GOTO ParamLoopContinue
 SET "BUILD_TARGET=x86_64"
 GOTO ParamLoopContinue
 
+:Profiling
+SET "CMAKE_PARAMS=%CMAKE_PARAMS% -DPROFILING=On"
+GOTO ParamLoopContinue
+
 :Verbose
 SET "BUILD_PARAMS=%BUILD_PARAMS% VERBOSE=1"
 GOTO ParamLoopContinue
@@ -77,6 +82,10 @@ GOTO ParamLoopContinue
         GOTO X64
     ) ELSE IF "%1"=="--x64" (
         GOTO X64
+    ) ELSE IF "%1"=="-p" (
+        GOTO Profiling
+    ) ELSE IF "%1"=="--profiling" (
+        GOTO Profiling
     ) ELSE IF "%1"=="-v" (
         GOTO Verbose
     ) ELSE IF "%1"=="--verbose" (
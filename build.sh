@@ -26,6 +26,7 @@ do
             printf -- "            --no-gdb            | -ng      ---   Add OS specific debug symbols rather than GDB's.\n"
             printf -- "            --no-extra-debug    | -ned     ---   Don't add extra debug symbols.\n"
             printf -- "            --no-optimise-debug | -nod     ---   Don't optimise debug mode builds.\n"
+            printf -- "            --profiling         | -p       ---   Compile in profiling zones.\n"
             printf -- "        Make flags:\n"
             printf -- "            --jobs X            | -j X     ---   Run compilation on X number of threads.\n"
             printf -- "            --verbose           | -v       ---   Run make with verbose set on.\n"
@@ -57,6 +58,9 @@ do
         -nod|--no-optimise-debug)
             CMAKE_PARAMS="$CMAKE_PARAMS -DOPTIMISE_ON_DEBUG=Off"
             ;;
+        -p|--profiling)
+            CMAKE_PARAMS="$CMAKE_PARAMS -DPROFILING=On"
+            ;;
         -j|--jobs)
             if ! [[ $2 =~ ^[0-9]+$ ]] ; then
                 echo "Error: Saw argument --jobs (-j) but it was not followed by a number of jobs to run."
@@ -9,17 +9,20 @@ in vec4 vPosition;
 in vec2 vRelativePosition;
 in vec4 vUVDimensions;
 in vec4 vColour;
+in int  vTextureIndex;
 
 // Data we want to send to be used for calculating colour of each pixel.
      out vec2 fRelativePosition;
 flat out vec4 fUVDimensions;
      out vec4 fColour;
+flat out int  fTextureIndex;
 
 void main() {
     // Send data we aren't transforming straight to the fragment shader.
     fRelativePosition = vRelativePosition;
     fUVDimensions     = vUVDimensions;
     fColour           = vColour;
+    fTextureIndex     = vTextureIndex;
 
     // Calculate the position of this vertex on the screen.
     vec4 worldPosition = WorldProjection * vPosition;
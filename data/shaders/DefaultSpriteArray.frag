@@ -0,0 +1,33 @@
+#version 330
+
+// Uniforms - things that are the same for all vertices.
+//     A batch draws either from a plain texture or from a texture array, never both.
+uniform sampler2D      SpriteTexture;
+uniform sampler2DArray SpriteTextureArray;
+
+// Data about this specific pixel (corresponds to the data we
+// sent here from the vertex shader).
+     in vec2 fRelativePosition;
+flat in vec4 fUVDimensions;
+     in vec4 fColour;
+flat in int  fTextureIndex;
+
+// The final colour of this pixel, this gets sent to the
+// framebuffer which will be rendered to the screen.
+out vec4 finalColour;
+
+void main() {
+    // Calculate the coordinates of the pixel to be taken from our texture, as in DefaultSprite.frag.
+    vec2 textureCoords = fRelativePosition.xy * fUVDimensions.zw + fUVDimensions.xy;
+
+    // Sprites whose texture is not in a texture array have a negative layer, and are drawn
+    // from the plain texture instead.
+    vec4 textureColour;
+    if (fTextureIndex < 0) {
+        textureColour = texture(SpriteTexture, textureCoords);
+    } else {
+        textureColour = texture(SpriteTextureArray, vec3(textureCoords, float(fTextureIndex)));
+    }
+
+    finalColour = textureColour * fColour;
+}
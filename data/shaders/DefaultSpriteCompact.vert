@@ -0,0 +1,31 @@
+#version 330
+
+// Uniforms - things that are the same for all vertices.
+uniform mat4 WorldProjection;
+uniform mat4 ViewProjection;
+
+// Data about this specific vertex (corresponds to our CompactSpriteVertex class).
+in vec4 vPosition;
+in vec2 vTextureCoords;
+in vec4 vColour;
+in int  vTextureIndex;
+
+// Data we want to send to be used for calculating colour of each pixel.
+     out vec2 fRelativePosition;
+flat out vec4 fUVDimensions;
+     out vec4 fColour;
+flat out int  fTextureIndex;
+
+void main() {
+    // Our texture coordinates are already final, so we pass them as the relative position
+    // within a rectangle covering the whole texture - the fragment shader then uses them
+    // as they are.
+    fRelativePosition = vTextureCoords;
+    fUVDimensions     = vec4(0.0, 0.0, 1.0, 1.0);
+    fColour           = vColour;
+    fTextureIndex     = vTextureIndex;
+
+    // Calculate the position of this vertex on the screen.
+    vec4 worldPosition = WorldProjection * vPosition;
+    gl_Position = ViewProjection * worldPosition;
+}
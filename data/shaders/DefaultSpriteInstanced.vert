@@ -0,0 +1,67 @@
+#version 330
+
+// Uniforms - things that are the same for all vertices.
+uniform mat4 WorldProjection;
+uniform mat4 ViewProjection;
+
+// Data about this specific instance (corresponds to our SpriteInstance class).
+in vec2 vPosition;
+in vec2 vSize;
+in float vDepth;
+in vec4 vUVDimensions;
+in vec4 vColour1;
+in vec4 vColour2;
+in uint vGradient;
+in int vTextureIndex;
+
+// Data we want to send to be used for calculating colour of each pixel.
+     out vec2 fRelativePosition;
+flat out vec4 fUVDimensions;
+     out vec4 fColour;
+flat out int  fTextureIndex;
+
+// These correspond to the values of the Gradient enum.
+const uint GRADIENT_NONE                     = 0u;
+const uint GRADIENT_LEFT_TO_RIGHT            = 1u;
+const uint GRADIENT_TOP_TO_BOTTOM            = 2u;
+const uint GRADIENT_TOP_LEFT_TO_BOTTOM_RIGHT = 3u;
+const uint GRADIENT_TOP_RIGHT_TO_BOTTOM_LEFT = 4u;
+
+void main() {
+    // Each instance is drawn as a triangle strip of four vertices, in the same order
+    // as buildQuad: top left, top right, bottom left, bottom right. From the ID of the
+    // vertex we can then get its relative position within the quad.
+    vec2 relativePosition = vec2(float(gl_VertexID & 1), float((gl_VertexID >> 1) & 1));
+
+    // Work out how far along the gradient this corner of the quad is, matching the
+    // colours buildQuad would assign to each corner.
+    float mixRatio = 0.0;
+    switch (vGradient) {
+        case GRADIENT_LEFT_TO_RIGHT:
+            mixRatio = relativePosition.x;
+            break;
+        case GRADIENT_TOP_TO_BOTTOM:
+            mixRatio = relativePosition.y;
+            break;
+        case GRADIENT_TOP_LEFT_TO_BOTTOM_RIGHT:
+            mixRatio = (relativePosition.x + relativePosition.y) / 2.0;
+            break;
+        case GRADIENT_TOP_RIGHT_TO_BOTTOM_LEFT:
+            mixRatio = (1.0 - relativePosition.x + relativePosition.y) / 2.0;
+            break;
+        default:
+            mixRatio = 0.0;
+            break;
+    }
+
+    // Send data we aren't transforming straight to the fragment shader.
+    fRelativePosition = relativePosition;
+    fUVDimensions     = vUVDimensions;
+    fColour           = mix(vColour1, vColour2, mixRatio);
+    fTextureIndex     = vTextureIndex;
+
+    // Calculate the position of this vertex on the screen.
+    vec4 position      = vec4(vPosition + relativePosition * vSize, vDepth, 1.0);
+    vec4 worldPosition = WorldProjection * position;
+    gl_Position = ViewProjection * worldPosition;
+}
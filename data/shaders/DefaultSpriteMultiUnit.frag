@@ -0,0 +1,47 @@
+#version 330
+
+// Uniforms - things that are the same for all vertices.
+//     Each batch binds up to 16 textures, one to each texture unit.
+uniform sampler2D SpriteTextures[16];
+
+// Data about this specific pixel (corresponds to the data we
+// sent here from the vertex shader).
+     in vec2 fRelativePosition;
+flat in vec4 fUVDimensions;
+     in vec4 fColour;
+flat in int  fTextureIndex;
+
+// The final colour of this pixel, this gets sent to the
+// framebuffer which will be rendered to the screen.
+out vec4 finalColour;
+
+void main() {
+    // Calculate the coordinates of the pixel to be taken from our texture, as in DefaultSprite.frag.
+    vec2 textureCoords = fRelativePosition.xy * fUVDimensions.zw + fUVDimensions.xy;
+
+    // Pick the texture from the slot this sprite was given.
+    //     GLSL 3.30 only lets us index arrays of samplers with constants, so we must switch
+    //     over each slot rather than index with fTextureIndex directly.
+    vec4 textureColour;
+    switch (fTextureIndex) {
+        case 0:  textureColour = texture(SpriteTextures[0],  textureCoords); break;
+        case 1:  textureColour = texture(SpriteTextures[1],  textureCoords); break;
+        case 2:  textureColour = texture(SpriteTextures[2],  textureCoords); break;
+        case 3:  textureColour = texture(SpriteTextures[3],  textureCoords); break;
+        case 4:  textureColour = texture(SpriteTextures[4],  textureCoords); break;
+        case 5:  textureColour = texture(SpriteTextures[5],  textureCoords); break;
+        case 6:  textureColour = texture(SpriteTextures[6],  textureCoords); break;
+        case 7:  textureColour = texture(SpriteTextures[7],  textureCoords); break;
+        case 8:  textureColour = texture(SpriteTextures[8],  textureCoords); break;
+        case 9:  textureColour = texture(SpriteTextures[9],  textureCoords); break;
+        case 10: textureColour = texture(SpriteTextures[10], textureCoords); break;
+        case 11: textureColour = texture(SpriteTextures[11], textureCoords); break;
+        case 12: textureColour = texture(SpriteTextures[12], textureCoords); break;
+        case 13: textureColour = texture(SpriteTextures[13], textureCoords); break;
+        case 14: textureColour = texture(SpriteTextures[14], textureCoords); break;
+        case 15: textureColour = texture(SpriteTextures[15], textureCoords); break;
+        default: textureColour = vec4(1.0); break;
+    }
+
+    finalColour = textureColour * fColour;
+}
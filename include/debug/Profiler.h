@@ -0,0 +1,195 @@
+/**
+ * @file Profiler.h
+ * @brief Provides scoped CPU timers and GPU timer queries that record into a ring buffer, which can be dumped as a Chrome trace.
+ */
+
+#pragma once
+
+#if !defined(SP_Debug_Profiler_h__)
+#define SP_Debug_Profiler_h__
+
+#include <atomic>
+#include <vector>
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace debug {
+        // The number of events the profiler keeps by default, after which the oldest are overwritten.
+        const size_t DEFAULT_PROFILER_CAPACITY = 1 << 16;
+        // The number of GPU timer queries kept in flight by default.
+        const ui32 DEFAULT_GPU_TIMER_QUERIES = 4;
+        // The thread ID events timed on the GPU are recorded under, such that they appear on their own track.
+        const ui32 GPU_THREAD_ID = 0xFFFF;
+
+        /**
+         * @brief A completed timing of a named zone.
+         */
+        struct ProfileEvent {
+            const char* name;     // Must outlive the profiler's use of it, e.g. a string literal.
+            const char* category;
+            ui64        start;    // Nanoseconds since the profiler was initialised.
+            ui64        duration; // Nanoseconds.
+            ui32        thread;
+        };
+
+        /**
+         * @brief Provides a process-wide ring buffer of profile events.
+         *
+         * Recording an event claims the next slot of the ring with a single atomic
+         * increment, so zones may be timed from any thread without locking. Once the
+         * ring is full, the oldest events are overwritten - so the ring always holds the
+         * most recent frames, ready to be dumped when something of interest happens.
+         *
+         * Nothing is recorded until the profiler is initialised. Dumping must not happen
+         * while events are being recorded, e.g. dump between frames.
+         */
+        class Profiler {
+        public:
+            /**
+             * @brief Initialises the profiler, allocating its ring buffer and starting
+             * its clock.
+             *
+             * @param capacity The number of events to keep.
+             */
+            static void init(size_t capacity = DEFAULT_PROFILER_CAPACITY);
+            /**
+             * @brief Disposes of the profiler and all recorded events.
+             */
+            static void dispose();
+
+            static bool isInitialised() { return !s_events.empty(); }
+
+            /**
+             * @return The number of nanoseconds passed since the profiler was initialised.
+             */
+            static ui64 now();
+            /**
+             * @return A small ID unique to the calling thread, assigned on first use.
+             */
+            static ui32 getThreadID();
+
+            /**
+             * @brief Records an event, overwriting the oldest if the ring is full.
+             *
+             * @param event The event to record.
+             */
+            static void record(const ProfileEvent& event);
+
+            /**
+             * @brief Copies the recorded events, oldest first.
+             *
+             * @param events Populated with the events, any existing events are cleared.
+             */
+            static void getEvents(std::vector<ProfileEvent>& events);
+
+            /**
+             * @brief Writes the recorded events as Chrome trace JSON, which may be loaded
+             * in chrome://tracing or Perfetto.
+             *
+             * @param filepath The filepath to write to.
+             *
+             * @return True if the trace was written, false otherwise.
+             */
+            static bool dumpChromeTrace(const char* filepath);
+        protected:
+            static std::vector<ProfileEvent> s_events;
+            static std::atomic<size_t>       s_next;
+            static ui64                      s_epoch;
+        };
+
+        /**
+         * @brief Times the scope it lives in on the CPU, recording the time taken with
+         * the profiler when destroyed.
+         */
+        class ScopedTimer {
+        public:
+            ScopedTimer(const char* name, const char* category = "cpu") :
+                m_name(name),
+                m_category(category),
+                m_start(Profiler::now())
+            { /* Empty */ }
+            ~ScopedTimer();
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+        protected:
+            const char* m_name;
+            const char* m_category;
+            ui64        m_start;
+        };
+
+        /**
+         * @brief Times work on the GPU with GL_TIME_ELAPSED queries, recording the times
+         * taken with the profiler once the GPU has them.
+         *
+         * Queries are kept in a ring and only read once their results are available, so
+         * timing never stalls the CPU waiting on the GPU. If every query is still in
+         * flight when a new timing begins, that timing is skipped. As the GPU gives only
+         * durations, each GPU event is placed at the CPU time its timing began.
+         *
+         * Only one GPU timer may be timing at any one time, per OpenGL's restriction on
+         * active queries.
+         */
+        class GPUTimer {
+        public:
+            GPUTimer();
+
+            /**
+             * @brief Initialises the timer, creating its queries.
+             *
+             * @param queryCount The number of queries to keep in flight.
+             */
+            void init(ui32 queryCount = DEFAULT_GPU_TIMER_QUERIES);
+            /**
+             * @brief Disposes of the timer and its queries. Results not yet read are lost.
+             */
+            void dispose();
+
+            /**
+             * @brief Begins timing GPU work under the given name.
+             *
+             * @param name The name of the work being timed.
+             */
+            void begin(const char* name);
+            /**
+             * @brief Ends the timing begun last.
+             */
+            void end();
+
+            /**
+             * @brief Records the times taken of any timings whose results are now
+             * available with the profiler.
+             */
+            void collect();
+        protected:
+            /**
+             * @brief The state of each query in the ring.
+             */
+            struct Query {
+                GLuint      id;
+                const char* name;
+                ui64        start;
+                bool        pending;
+            };
+
+            std::vector<Query> m_queries;
+            ui32               m_current;
+            bool               m_timing;
+        };
+    }
+}
+namespace spdebug = SecretProject::debug;
+
+// The zones below are compiled in only when profiling, which is enabled with the PROFILING CMake option.
+#if defined(SP_PROFILING)
+    #define SP_PROFILE_CONCAT_IMPL(a, b) a##b
+    #define SP_PROFILE_CONCAT(a, b)      SP_PROFILE_CONCAT_IMPL(a, b)
+
+    // Times the rest of the enclosing scope under the given name.
+    #define SP_PROFILE_ZONE(name) spdebug::ScopedTimer SP_PROFILE_CONCAT(spProfileZone, __LINE__)(name)
+#else
+    #define SP_PROFILE_ZONE(name)
+#endif
+
+#endif // !defined(SP_Debug_Profiler_h__)
@@ -0,0 +1,96 @@
+/**
+ * @file ClipStack.h
+ * @brief Provides a stack of clip rectangles, recording each rectangle pushed so sprites can refer to it by index.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_ClipStack_h__)
+#define SP_Graphics_ClipStack_h__
+
+#include <vector>
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace graphics {
+        // The clip index of sprites that are not clipped.
+        const ui32 NO_CLIP = 0;
+
+        /**
+         * @brief Provides a stack of clip rectangles. Each rectangle pushed is intersected
+         * with the one beneath it, so nested rectangles never draw outside of their
+         * parents, and is recorded for the rest of the batching phase so that sprites can
+         * refer to the rectangle they are clipped by with just an index.
+         *
+         * Clip rectangles are given as (x, y, width, height), in the same coordinates
+         * sprites are drawn in.
+         */
+        class ClipStack {
+        public:
+            /**
+             * @brief Pushes the given rectangle, intersected with the current clip
+             * rectangle, onto the stack.
+             *
+             * @param rect The rectangle to clip to.
+             *
+             * @return The index of the resulting clip rectangle.
+             */
+            ui32 push(const f32v4& rect);
+            /**
+             * @brief Pops the current clip rectangle off of the stack. The rectangle
+             * remains recorded, so sprites already clipped by it are unaffected.
+             */
+            void pop();
+
+            /**
+             * @brief Forgets all clip rectangles, ready for a new batching phase.
+             */
+            void clear();
+            /**
+             * @brief Forgets all clip rectangles, releasing their memory.
+             */
+            void dispose();
+
+            /**
+             * @brief Records the clip rectangles of the given stack after ours.
+             *
+             * @param other The stack whose clip rectangles to record.
+             *
+             * @return The offset to add to the clip indices of sprites clipped by the
+             * other stack, for them to refer to the same rectangles in ours.
+             */
+            ui32 append(const ClipStack& other);
+
+            /**
+             * @return The index of the current clip rectangle, or NO_CLIP if the stack is empty.
+             */
+            ui32 getCurrent() const { return m_stack.empty() ? NO_CLIP : m_stack.back(); }
+            /**
+             * @param index The index of the clip rectangle to get, which must not be NO_CLIP.
+             *
+             * @return The clip rectangle of the given index.
+             */
+            const f32v4& getRect(ui32 index) const { return m_rects[index - 1]; }
+        protected:
+            std::vector<f32v4> m_rects;
+            std::vector<ui32>  m_stack;
+        };
+
+        /**
+         * @brief Projects the given clip rectangle into window coordinates, giving the smallest
+         * scissor rectangle that covers it.
+         *
+         * @param rect The clip rectangle to project.
+         * @param transform The transform from the coordinates sprites are drawn in to clip space.
+         * @param viewport The viewport, as (x, y, width, height).
+         *
+         * @return The scissor rectangle, as (x, y, width, height) with the origin at the bottom
+         * left of the window.
+         */
+        i32v4 projectClipRect(const f32v4& rect, const f32m4& transform, const i32v4& viewport);
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_ClipStack_h__)
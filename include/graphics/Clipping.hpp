@@ -10,10 +10,40 @@
 
 #include <type_traits>
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "types.h"
 
 namespace SecretProject {
     namespace graphics {
+        // The number of objects clipMany clips at a time, depending on the instruction sets targeted.
+#if defined(__AVX__)
+        const size_t CLIP_MANY_LANES = 8;
+#elif defined(__SSE2__)
+        const size_t CLIP_MANY_LANES = 4;
+#else
+        const size_t CLIP_MANY_LANES = 1;
+#endif
+
+        /**
+         * @brief Determines if an object with the given position and size lies entirely within
+         * the given clip rectangle.
+         *
+         * @param clip The clip rectangle to test against.
+         * @param position The position of the object to test.
+         * @param size The size of the object to test.
+         *
+         * @return True if the object lies entirely within the clip rectangle, false otherwise.
+         */
+        inline bool contains(const f32v4& clip, const f32v2& position, const f32v2& size) {
+            return position.x >= clip.x && position.x + size.x <= clip.x + clip.z
+                    && position.y >= clip.y && position.y + size.y <= clip.y + clip.w;
+        }
+
         /**
          * @brief Clips an object with the given position, size and UV coordinates & size, such that
          * it entirely fits within the given clip rectangle.
@@ -25,7 +55,7 @@ namespace SecretProject {
          *
          * @return True if any of the properties of the object were changed, false otherwise.
          */
-        bool clip(const f32v4& clip, f32v2& position, f32v2& size, f32v4& uvDimensions) {
+        inline bool clip(const f32v4& clip, f32v2& position, f32v2& size, f32v4& uvDimensions) {
             // Flag of if anything has changed.
             bool changed = false;
 
@@ -99,6 +129,256 @@ namespace SecretProject {
 
             return changed;
         }
+
+        // Flags set by clipMany for each object.
+        //     CLIP_KEEP is set if any of the object remains after clipping.
+        //     CLIP_PARTIAL is set if any of the object's properties were changed.
+        const ui8 CLIP_KEEP    = 0x1;
+        const ui8 CLIP_PARTIAL = 0x2;
+
+        /**
+         * @brief The properties of a number of objects to clip together, each property held in
+         * its own array (i.e. as a structure of arrays) so that they can be clipped several at
+         * a time. Every array must hold at least as many values as there are objects.
+         */
+        struct ClipStreams {
+            f32* x;
+            f32* y;
+            f32* width;
+            f32* height;
+            f32* u;
+            f32* v;
+            f32* uvWidth;
+            f32* uvHeight;
+        };
+
+        /**
+         * @brief Clips the objects from begin up to end one at a time, exactly as clip would
+         * if given each object in turn. Used by clipMany for whatever doesn't fill a vector.
+         *
+         * @param clip The clip rectangle to clip to.
+         * @param objects The objects to clip.
+         * @param flags Set to the clip flags of each object.
+         * @param begin The index of the first object to clip.
+         * @param end The index after the last object to clip.
+         *
+         * @return The number of objects kept.
+         */
+        inline size_t clipManyScalar(const f32v4& clip, ClipStreams& objects, ui8* flags, size_t begin, size_t end) {
+            size_t kept = 0;
+            for (size_t i = begin; i < end; ++i) {
+                f32v2 position(objects.x[i], objects.y[i]);
+                f32v2 size(objects.width[i], objects.height[i]);
+                f32v4 uvDimensions(objects.u[i], objects.v[i], objects.uvWidth[i], objects.uvHeight[i]);
+
+                bool changed = graphics::clip(clip, position, size, uvDimensions);
+                bool keep    = size.x > 0.0f && size.y > 0.0f;
+
+                objects.x[i]        = position.x;
+                objects.y[i]        = position.y;
+                objects.width[i]    = size.x;
+                objects.height[i]   = size.y;
+                objects.u[i]        = uvDimensions.x;
+                objects.v[i]        = uvDimensions.y;
+                objects.uvWidth[i]  = uvDimensions.z;
+                objects.uvHeight[i] = uvDimensions.w;
+
+                flags[i] = static_cast<ui8>((keep ? CLIP_KEEP : 0) | (changed ? CLIP_PARTIAL : 0));
+                kept    += keep;
+            }
+            return kept;
+        }
+
+        /**
+         * @brief Writes the clip flags of a vector's worth of objects from the masks of which
+         * lanes were kept and which were changed.
+         *
+         * @param flags The flags of the first object of the vector.
+         * @param keepBits The mask of lanes kept.
+         * @param partialBits The mask of lanes changed.
+         * @param lanes The number of lanes in the vector.
+         *
+         * @return The number of objects kept.
+         */
+        inline size_t writeClipFlags(ui8* flags, ui32 keepBits, ui32 partialBits, size_t lanes) {
+            size_t kept = 0;
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                ui32 keep    = (keepBits    >> lane) & 1;
+                ui32 partial = (partialBits >> lane) & 1;
+
+                flags[lane] = static_cast<ui8>(keep * CLIP_KEEP | partial * CLIP_PARTIAL);
+                kept       += keep;
+            }
+            return kept;
+        }
+
+        /**
+         * @brief Clips many objects to the given clip rectangle, giving the same results as
+         * calling clip on each object in turn.
+         *
+         * Rather than branching on each edge of each object, each edge is clipped by however
+         * much (possibly nothing) the object extends beyond it. Without branches, 8 objects
+         * are clipped at a time with AVX, or 4 with SSE2, where the compiler targets them.
+         * SSE2 is all an x86-64 build targets by default, configure with SIMD_AVX2 on for
+         * the 8-wide path. There is deliberately no 16-wide AVX-512 path, as few consumer
+         * processors support it and the 8-wide path is already bound by memory traffic.
+         *
+         * This is a standalone utility for callers holding objects as streams: the renderer
+         * has no caller of it, sprite culling and the string drawers still clip per object.
+         *
+         * @param clip The clip rectangle to clip to.
+         * @param objects The objects to clip, updated in place.
+         * @param flags Set to the clip flags (CLIP_KEEP, CLIP_PARTIAL) of each object.
+         * @param count The number of objects to clip.
+         *
+         * @return The number of objects kept.
+         */
+        inline size_t clipMany(const f32v4& clip, ClipStreams& objects, ui8* flags, size_t count) {
+            size_t i    = 0;
+            size_t kept = 0;
+
+#if defined(__AVX__)
+            const __m256 zero   = _mm256_setzero_ps();
+            const __m256 left   = _mm256_set1_ps(clip.x);
+            const __m256 top    = _mm256_set1_ps(clip.y);
+            const __m256 right  = _mm256_set1_ps(clip.x + clip.z);
+            const __m256 bottom = _mm256_set1_ps(clip.y + clip.w);
+
+            for (; i + 8 <= count; i += 8) {
+                __m256 x        = _mm256_loadu_ps(objects.x        + i);
+                __m256 y        = _mm256_loadu_ps(objects.y        + i);
+                __m256 width    = _mm256_loadu_ps(objects.width    + i);
+                __m256 height   = _mm256_loadu_ps(objects.height   + i);
+                __m256 u        = _mm256_loadu_ps(objects.u        + i);
+                __m256 v        = _mm256_loadu_ps(objects.v        + i);
+                __m256 uvWidth  = _mm256_loadu_ps(objects.uvWidth  + i);
+                __m256 uvHeight = _mm256_loadu_ps(objects.uvHeight + i);
+
+                // Left edge - shifts the start of the object and its UVs. The start is moved onto the edge
+                // rather than by delta, as x + (left - x) need not round back to left, and clip sets it exactly.
+                __m256 delta   = _mm256_max_ps(_mm256_sub_ps(left, x), zero);
+                __m256 clipped = _mm256_cmp_ps(delta, zero, _CMP_GT_OQ);
+                __m256 partial = clipped;
+                __m256 ratio   = _mm256_and_ps(clipped, _mm256_div_ps(delta, width));
+                __m256 uvDelta = _mm256_mul_ps(uvWidth, ratio);
+                u       = _mm256_add_ps(u, uvDelta);
+                uvWidth = _mm256_sub_ps(uvWidth, uvDelta);
+                x       = _mm256_max_ps(x, left);
+                width   = _mm256_sub_ps(width, delta);
+
+                // Right edge - shortens the object and its UVs.
+                delta   = _mm256_max_ps(_mm256_sub_ps(_mm256_add_ps(x, width), right), zero);
+                clipped = _mm256_cmp_ps(delta, zero, _CMP_GT_OQ);
+                partial = _mm256_or_ps(partial, clipped);
+                ratio   = _mm256_and_ps(clipped, _mm256_div_ps(delta, width));
+                uvWidth = _mm256_sub_ps(uvWidth, _mm256_mul_ps(uvWidth, ratio));
+                width   = _mm256_sub_ps(width, delta);
+
+                // Top edge.
+                delta    = _mm256_max_ps(_mm256_sub_ps(top, y), zero);
+                clipped  = _mm256_cmp_ps(delta, zero, _CMP_GT_OQ);
+                partial  = _mm256_or_ps(partial, clipped);
+                ratio    = _mm256_and_ps(clipped, _mm256_div_ps(delta, height));
+                uvDelta  = _mm256_mul_ps(uvHeight, ratio);
+                v        = _mm256_add_ps(v, uvDelta);
+                uvHeight = _mm256_sub_ps(uvHeight, uvDelta);
+                y        = _mm256_max_ps(y, top);
+                height   = _mm256_sub_ps(height, delta);
+
+                // Bottom edge.
+                delta    = _mm256_max_ps(_mm256_sub_ps(_mm256_add_ps(y, height), bottom), zero);
+                clipped  = _mm256_cmp_ps(delta, zero, _CMP_GT_OQ);
+                partial  = _mm256_or_ps(partial, clipped);
+                ratio    = _mm256_and_ps(clipped, _mm256_div_ps(delta, height));
+                uvHeight = _mm256_sub_ps(uvHeight, _mm256_mul_ps(uvHeight, ratio));
+                height   = _mm256_sub_ps(height, delta);
+
+                _mm256_storeu_ps(objects.x        + i, x);
+                _mm256_storeu_ps(objects.y        + i, y);
+                _mm256_storeu_ps(objects.width    + i, width);
+                _mm256_storeu_ps(objects.height   + i, height);
+                _mm256_storeu_ps(objects.u        + i, u);
+                _mm256_storeu_ps(objects.v        + i, v);
+                _mm256_storeu_ps(objects.uvWidth  + i, uvWidth);
+                _mm256_storeu_ps(objects.uvHeight + i, uvHeight);
+
+                __m256 keep = _mm256_and_ps(_mm256_cmp_ps(width, zero, _CMP_GT_OQ), _mm256_cmp_ps(height, zero, _CMP_GT_OQ));
+
+                kept += writeClipFlags(flags + i, static_cast<ui32>(_mm256_movemask_ps(keep)), static_cast<ui32>(_mm256_movemask_ps(partial)), 8);
+            }
+#elif defined(__SSE2__)
+            const __m128 zero   = _mm_setzero_ps();
+            const __m128 left   = _mm_set1_ps(clip.x);
+            const __m128 top    = _mm_set1_ps(clip.y);
+            const __m128 right  = _mm_set1_ps(clip.x + clip.z);
+            const __m128 bottom = _mm_set1_ps(clip.y + clip.w);
+
+            for (; i + 4 <= count; i += 4) {
+                __m128 x        = _mm_loadu_ps(objects.x        + i);
+                __m128 y        = _mm_loadu_ps(objects.y        + i);
+                __m128 width    = _mm_loadu_ps(objects.width    + i);
+                __m128 height   = _mm_loadu_ps(objects.height   + i);
+                __m128 u        = _mm_loadu_ps(objects.u        + i);
+                __m128 v        = _mm_loadu_ps(objects.v        + i);
+                __m128 uvWidth  = _mm_loadu_ps(objects.uvWidth  + i);
+                __m128 uvHeight = _mm_loadu_ps(objects.uvHeight + i);
+
+                // Left edge - shifts the start of the object and its UVs, moving it onto the edge as above.
+                __m128 delta   = _mm_max_ps(_mm_sub_ps(left, x), zero);
+                __m128 clipped = _mm_cmpgt_ps(delta, zero);
+                __m128 partial = clipped;
+                __m128 ratio   = _mm_and_ps(clipped, _mm_div_ps(delta, width));
+                __m128 uvDelta = _mm_mul_ps(uvWidth, ratio);
+                u       = _mm_add_ps(u, uvDelta);
+                uvWidth = _mm_sub_ps(uvWidth, uvDelta);
+                x       = _mm_max_ps(x, left);
+                width   = _mm_sub_ps(width, delta);
+
+                // Right edge - shortens the object and its UVs.
+                delta   = _mm_max_ps(_mm_sub_ps(_mm_add_ps(x, width), right), zero);
+                clipped = _mm_cmpgt_ps(delta, zero);
+                partial = _mm_or_ps(partial, clipped);
+                ratio   = _mm_and_ps(clipped, _mm_div_ps(delta, width));
+                uvWidth = _mm_sub_ps(uvWidth, _mm_mul_ps(uvWidth, ratio));
+                width   = _mm_sub_ps(width, delta);
+
+                // Top edge.
+                delta    = _mm_max_ps(_mm_sub_ps(top, y), zero);
+                clipped  = _mm_cmpgt_ps(delta, zero);
+                partial  = _mm_or_ps(partial, clipped);
+                ratio    = _mm_and_ps(clipped, _mm_div_ps(delta, height));
+                uvDelta  = _mm_mul_ps(uvHeight, ratio);
+                v        = _mm_add_ps(v, uvDelta);
+                uvHeight = _mm_sub_ps(uvHeight, uvDelta);
+                y        = _mm_max_ps(y, top);
+                height   = _mm_sub_ps(height, delta);
+
+                // Bottom edge.
+                delta    = _mm_max_ps(_mm_sub_ps(_mm_add_ps(y, height), bottom), zero);
+                clipped  = _mm_cmpgt_ps(delta, zero);
+                partial  = _mm_or_ps(partial, clipped);
+                ratio    = _mm_and_ps(clipped, _mm_div_ps(delta, height));
+                uvHeight = _mm_sub_ps(uvHeight, _mm_mul_ps(uvHeight, ratio));
+                height   = _mm_sub_ps(height, delta);
+
+                _mm_storeu_ps(objects.x        + i, x);
+                _mm_storeu_ps(objects.y        + i, y);
+                _mm_storeu_ps(objects.width    + i, width);
+                _mm_storeu_ps(objects.height   + i, height);
+                _mm_storeu_ps(objects.u        + i, u);
+                _mm_storeu_ps(objects.v        + i, v);
+                _mm_storeu_ps(objects.uvWidth  + i, uvWidth);
+                _mm_storeu_ps(objects.uvHeight + i, uvHeight);
+
+                __m128 keep = _mm_and_ps(_mm_cmpgt_ps(width, zero), _mm_cmpgt_ps(height, zero));
+
+                kept += writeClipFlags(flags + i, static_cast<ui32>(_mm_movemask_ps(keep)), static_cast<ui32>(_mm_movemask_ps(partial)), 4);
+            }
+#endif
+
+            // Clip whatever is left one at a time.
+            return kept + clipManyScalar(clip, objects, flags, i, count);
+        }
     }
 }
 namespace spg = SecretProject::graphics;
@@ -10,12 +10,23 @@
 
 #include "types.h"
 #include <unordered_map>
+#include <vector>
 
 namespace SecretProject {
     namespace graphics {
         const char FIRST_PRINTABLE_CHAR = 32;
         const char LAST_PRINTABLE_CHAR  = 126;
 
+        // Kerning is kept between each pair of printable ASCII characters, in a table this many glyphs wide.
+        const char32_t KERNING_TABLE_WIDTH = LAST_PRINTABLE_CHAR - FIRST_PRINTABLE_CHAR + 1;
+
+        // Glyphs are stored in pages of this many consecutive codepoints.
+        const char32_t GLYPH_PAGE_SIZE  = 256;
+        // The number of pages covering the Basic Multilingual Plane, the codepoints SDL_ttf renders glyphs of.
+        const char32_t GLYPH_PAGE_COUNT = 0x10000 / GLYPH_PAGE_SIZE;
+        // The last codepoint a font may have a glyph for.
+        const char32_t LAST_GLYPH_CODEPOINT = GLYPH_PAGE_COUNT * GLYPH_PAGE_SIZE - 1;
+
         /**
          * @brief Type used for font size in exposed APIs.
          *
@@ -48,12 +59,73 @@ namespace SecretProject {
 
         /**
          * @brief Data for each glyph.
+         *
+         * Size is that of the glyph as rendered into the font instance's texture, while
+         * advance is how far the pen moves on from the glyph, and bearing the horizontal
+         * offset from the pen to the left edge of the rendered glyph.
          */
         struct Glyph {
-            char  character;
-            f32v4 uvDimensions;
-            f32v2 size;
-            bool supported;
+            char32_t character;
+            f32v4    uvDimensions;
+            f32v2    size;
+            bool     supported;
+            f32      advance;
+            f32      bearing;
+        };
+
+        /**
+         * @brief Provides a two-level table of glyphs, keyed by codepoint.
+         *
+         * The first level maps each page of GLYPH_PAGE_SIZE consecutive codepoints to where
+         * that page's glyphs are stored in the second, and only pages with some glyph in
+         * them are stored. So finding a glyph is just two array reads, dense text such as
+         * ASCII stays within a page or two, and sparse scripts such as CJK pay only for
+         * the pages they use.
+         *
+         * All glyphs must be inserted before any are found, as inserting may move them.
+         */
+        class GlyphTable {
+        public:
+            GlyphTable();
+
+            /**
+             * @brief Gets the glyph of the given codepoint, adding it if the table doesn't
+             * yet have one. Added glyphs are unsupported until set otherwise.
+             *
+             * @param codepoint The codepoint of the glyph, at most LAST_GLYPH_CODEPOINT.
+             *
+             * @return The glyph.
+             */
+            Glyph& insert(char32_t codepoint);
+
+            /**
+             * @param codepoint The codepoint to find the glyph of.
+             *
+             * @return The glyph of the given codepoint, or nullptr if the table has no
+             * supported glyph for it.
+             */
+            const Glyph* find(char32_t codepoint) const {
+                if (codepoint > LAST_GLYPH_CODEPOINT) return nullptr;
+
+                ui16 page = m_directory[codepoint / GLYPH_PAGE_SIZE];
+                if (page == NO_GLYPH_PAGE) return nullptr;
+
+                const Glyph& glyph = m_glyphs[page * GLYPH_PAGE_SIZE + codepoint % GLYPH_PAGE_SIZE];
+
+                return glyph.supported ? &glyph : nullptr;
+            }
+        protected:
+            static constexpr ui16 NO_GLYPH_PAGE = 0xFFFF;
+
+            ui16               m_directory[GLYPH_PAGE_COUNT]; // Where each page's glyphs start in m_glyphs, in pages, or NO_GLYPH_PAGE.
+            std::vector<Glyph> m_glyphs;
+        };
+
+        /**
+         * @brief An inclusive range of codepoints a font generates glyphs for.
+         */
+        struct CodepointRange {
+            char32_t first, last;
         };
 
         // Forward declare Font.
@@ -65,22 +137,28 @@ namespace SecretProject {
          * Each font instance consists of a texture which contains each glyph (character) in
          * the font drawn in the size, style and render style specified for the instance. In
          * addition to this texture, it contains a parameter defining the height of the
-         * tallest character, as well as an array of metadata for each glyph.
+         * tallest character, as well as a table of metadata for each glyph.
          *     The metadata, Glyph, stores the character, the UV coordinates withing the
          *     texture of the glyph the metadata represents, and the size of the glyph in
          *     pixels.
+         * Kerning between each pair of printable ASCII characters is looked up at
+         * generation, so that layout needs no calls into SDL_ttf. The table is dense,
+         * indexed by the offset of the first character of a pair from FIRST_PRINTABLE_CHAR
+         * times KERNING_TABLE_WIDTH plus that of the second, and is null if the font kerns
+         * no pair at all.
          */
         struct FontInstance {
-            GLuint texture;
-            ui32   height;
-            Glyph* glyphs;
-            Font*  owner;
-            ui32v2 textureSize;
+            GLuint      texture;
+            ui32        height;
+            GlyphTable* glyphs;
+            Font*       owner;
+            ui32v2      textureSize;
+            i16*        kerning;
 
             bool saveAsBinary(const char* name);
             bool saveAsPng(const char* name);
         };
-        const FontInstance NIL_FONT_INSTANCE = { 0, 0, nullptr, nullptr, ui32v2(0) };
+        const FontInstance NIL_FONT_INSTANCE = { 0, 0, nullptr, nullptr, ui32v2(0), nullptr };
 
         /**
          * @brief Whether the string should be sized (vertically) by a scale factor or target a fixed pixel height.
@@ -112,7 +190,8 @@ namespace SecretProject {
             StringSizing sizing;
             colour4      tint;
         };
-        using StringComponents = std::vector<std::pair<const char*, StringDrawProperties>>;
+        using StringComponent  = std::pair<const char*, StringDrawProperties>;
+        using StringComponents = std::vector<StringComponent>;
 
         /**
          * @brief Handles a single font (defined by a single TTF file), for which textures
@@ -130,10 +209,10 @@ namespace SecretProject {
              * @brief Initialises the font, after which it is ready to generate glyphs of specified sizes and styles.
              *
              * @param filepath The path to the font's TTF file.
-             * @param start The first character to generate a glyph for.
-             * @param end The final character to generate a glyph for.
+             * @param start The first codepoint to generate a glyph for.
+             * @param end The final codepoint to generate a glyph for.
              */
-            void init(const char* filepath, char start, char end);
+            void init(const char* filepath, char32_t start, char32_t end);
             /**
              * @brief Initialises the font, after which it is ready to generate glyphs of specified sizes and styles.
              *
@@ -150,8 +229,19 @@ namespace SecretProject {
              */
             void dispose();
 
-            char getStart() { return m_start; }
-            char getEnd()   { return m_end;   }
+            /**
+             * @brief Adds a range of codepoints to generate glyphs for, in any font instances
+             * generated from then on.
+             *
+             * Codepoints beyond LAST_GLYPH_CODEPOINT are not rendered by SDL_ttf, and so
+             * are left out of the range.
+             *
+             * @param start The first codepoint to generate a glyph for.
+             * @param end The final codepoint to generate a glyph for.
+             */
+            void addCodepoints(char32_t start, char32_t end);
+
+            const std::vector<CodepointRange>& getCodepoints() { return m_codepoints; }
 
             FontSize getDefaultSize()              { return m_defaultSize; }
             void     setDefaultSize(FontSize size) { m_defaultSize = size; }
@@ -244,18 +334,19 @@ namespace SecretProject {
              * @brief Generates as many rows of glyphs as requested, ensuring 
              * each row is as similarly wide as every other row.
              *
-             * @param glyphs The size of each glyph to be fit into the rows.
+             * @param glyphs The glyphs to be fit into the rows.
+             * @param glyphCount The number of glyphs.
              * @param rowCount The number of rows to split the glyphs into.
              * @param padding The padding to be placed between each glyph.
              * @param width This is set to the width of the longest row generated.
              * @param height This is set to the sum of the max height of each glyph in each row.
              */
-            Row* generateRows(Glyph* glyphs, ui32 rowCount, FontSize padding, ui32& maxWidth, ui32& maxHeight);
+            Row* generateRows(Glyph* const* glyphs, ui32 glyphCount, ui32 rowCount, FontSize padding, ui32& maxWidth, ui32& maxHeight);
 
-            const char*     m_filepath;
-            char            m_start, m_end;
-            FontSize        m_defaultSize;
-            FontInstanceMap m_fontInstances;
+            const char*                 m_filepath;
+            std::vector<CodepointRange> m_codepoints;
+            FontSize                    m_defaultSize;
+            FontInstanceMap             m_fontInstances;
         };
 
         // TODO(Matthew): Implement font instance disposal.
@@ -280,12 +371,12 @@ namespace SecretProject {
              *
              * @param name The name to give the font.
              * @param filepath The filepath to the font's TTF file.
-             * @param start The first character to generate a glyph for.
-             * @param end The final character to generate a glyph for.
+             * @param start The first codepoint to generate a glyph for.
+             * @param end The final codepoint to generate a glyph for.
              *
              * @return True if the font was newly registered, false if a font with the same name already exists.
              */
-            bool registerFont(const char* name, const char* filepath, char start, char end);
+            bool registerFont(const char* name, const char* filepath, char32_t start, char32_t end);
             /**
              * @brief Register a font with the given name and filepath.
              *
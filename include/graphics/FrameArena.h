@@ -0,0 +1,126 @@
+/**
+ * @file FrameArena.h
+ * @brief Provides a bump allocator for transient allocations that last no longer than a batching phase.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_FrameArena_h__)
+#define SP_Graphics_FrameArena_h__
+
+#include <cstddef>
+#include <vector>
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace graphics {
+        // The size of the first block a frame arena allocates, in bytes.
+        const size_t DEFAULT_FRAME_ARENA_BLOCK_SIZE = 64 * 1024;
+
+        /**
+         * @brief Provides a linear allocator, handing out memory by bumping an offset
+         * into a block and freeing everything at once when reset.
+         *
+         * When a block runs out, another at least twice its size is allocated. On reset,
+         * if more than one block was in use they are replaced by a single block as large
+         * as all of them together - so once an arena has seen its busiest phase, it
+         * makes no further heap allocations.
+         *
+         * An arena is not thread safe, each thread must allocate from its own.
+         */
+        class FrameArena {
+        public:
+            FrameArena();
+            ~FrameArena();
+
+            FrameArena(const FrameArena&) = delete;
+            FrameArena& operator=(const FrameArena&) = delete;
+
+            /**
+             * @brief Allocates the given number of bytes, valid until the arena is next
+             * reset or disposed.
+             *
+             * @param bytes The number of bytes to allocate.
+             * @param alignment The alignment of the allocation, which must be a power of two.
+             *
+             * @return The allocated memory.
+             */
+            void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+            /**
+             * @brief Frees all allocations at once, keeping the arena's memory for reuse.
+             */
+            void reset();
+            /**
+             * @brief Frees all allocations and releases the arena's memory.
+             */
+            void dispose();
+
+            /**
+             * @return The number of bytes allocated since the arena was last reset,
+             * including any padding for alignment.
+             */
+            size_t getUsed() const { return m_used + m_offset; }
+            /**
+             * @return The number of bytes the arena holds across all its blocks.
+             */
+            size_t getCapacity() const;
+        protected:
+            /**
+             * @brief Adds a block of at least the given size to allocate from.
+             *
+             * @param minimumSize The fewest bytes the block must hold.
+             */
+            void addBlock(size_t minimumSize);
+
+            /**
+             * @brief A block of memory allocations are bumped through.
+             */
+            struct Block {
+                ui8*   data;
+                size_t size;
+            };
+
+            std::vector<Block> m_blocks; // Allocations are made from the last.
+            size_t             m_offset; // The offset into the last block of the next allocation.
+            size_t             m_used;   // The bytes used of all blocks but the last.
+        };
+
+        /**
+         * @brief An allocator for standard containers, allocating from a frame arena.
+         *
+         * Deallocation does nothing, the memory is only reclaimed when the arena is reset
+         * - so any container using one must not be used past then.
+         */
+        template <typename Type>
+        class ArenaAllocator {
+            template <typename Other>
+            friend class ArenaAllocator;
+        public:
+            using value_type = Type;
+
+            ArenaAllocator(FrameArena* arena) : m_arena(arena) { /* Empty */ }
+            template <typename Other>
+            ArenaAllocator(const ArenaAllocator<Other>& other) : m_arena(other.m_arena) { /* Empty */ }
+
+            Type* allocate(size_t count) {
+                return static_cast<Type*>(m_arena->allocate(count * sizeof(Type), alignof(Type)));
+            }
+            void deallocate(Type*, size_t) { /* Empty */ }
+
+            template <typename Other>
+            bool operator==(const ArenaAllocator<Other>& rhs) const { return m_arena == rhs.m_arena; }
+            template <typename Other>
+            bool operator!=(const ArenaAllocator<Other>& rhs) const { return m_arena != rhs.m_arena; }
+        protected:
+            FrameArena* m_arena;
+        };
+
+        template <typename Type>
+        using ArenaVector = std::vector<Type, ArenaAllocator<Type>>;
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_FrameArena_h__)
@@ -0,0 +1,99 @@
+/**
+ * @file QuadIndexBuffer.h
+ * @brief Provides a process-wide index buffer for drawing quads.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_QuadIndexBuffer_h__)
+#define SP_Graphics_QuadIndexBuffer_h__
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace graphics {
+        // The most quads that can be indexed with 16-bit indices - four vertices each,
+        // with 65536 vertices addressable.
+        const ui32 MAX_SHORT_INDEXED_QUADS = 16384;
+        // The number of quads indexed with 32-bit indices by default.
+        const ui32 DEFAULT_MAX_INDEXED_QUADS = 65536;
+
+        /**
+         * @brief Provides a single index buffer, shared by everything drawing quads, that
+         * is generated once and never changes after.
+         *
+         * As the index pattern for quads is the same for every quad, all quads can be
+         * drawn with indices starting from zero, offset to the right vertices with a base
+         * vertex. The buffer holds 16-bit indices for MAX_SHORT_INDEXED_QUADS quads,
+         * used for all but the largest draws, followed by 32-bit indices for a
+         * configurable maximum number of quads. Draws of more quads than that maximum are
+         * split into several draws.
+         *
+         * The buffer is reference counted, being created on first acquisition and
+         * deleted on last release. All users must share the same GL context (or contexts
+         * sharing objects).
+         */
+        class QuadIndexBuffer {
+        public:
+            /**
+             * @brief Acquires the shared index buffer, creating it if need be.
+             *
+             * @return The ID of the index buffer.
+             */
+            static GLuint acquire();
+            /**
+             * @brief Releases the shared index buffer, deleting it if this was the last
+             * acquisition.
+             */
+            static void release();
+
+            /**
+             * @brief Sets the number of quads the 32-bit indices of the buffer cover. If
+             * the buffer exists and covers fewer quads, it is regenerated in place, so any
+             * vertex arrays with it bound remain valid.
+             *
+             * @param maxQuads The number of quads to cover, at least MAX_SHORT_INDEXED_QUADS.
+             */
+            static void setMaxQuads(ui32 maxQuads);
+            static ui32 getMaxQuads() { return s_maxQuads; }
+
+            static GLuint getID() { return s_id; }
+
+            /**
+             * @return The number of bytes of indices sent to the GPU, over all
+             * generations of the buffer.
+             */
+            static ui64 getBytesUploaded()   { return s_bytesUploaded;   }
+            /**
+             * @return The number of times the buffer's contents have been generated.
+             */
+            static ui32 getGenerationCount() { return s_generationCount; }
+
+            /**
+             * @brief Draws the given number of quads using the shared index buffer, which
+             * must be bound to the current vertex array.
+             *
+             * @param quadCount The number of quads to draw.
+             * @param baseVertex The index of the first vertex of the first quad in the
+             * bound vertex buffer.
+             *
+             * @return The number of draw calls issued.
+             */
+            static ui32 draw(ui32 quadCount, GLint baseVertex);
+        protected:
+            /**
+             * @brief Generates the contents of the buffer, which must be bound.
+             */
+            static void generate();
+
+            static GLuint s_id;
+            static ui32   s_refCount;
+            static ui32   s_maxQuads;
+            static ui64   s_bytesUploaded;
+            static ui32   s_generationCount;
+        };
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_QuadIndexBuffer_h__)
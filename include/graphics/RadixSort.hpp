@@ -0,0 +1,109 @@
+/**
+ * @file RadixSort.hpp
+ * @brief Provides a stable LSD radix sort of 64-bit keys carrying 32-bit indices, and helpers for building keys.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_RadixSort_h__)
+#define SP_Graphics_RadixSort_h__
+
+#include <cstring>
+#include <utility>
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace graphics {
+        const size_t RADIX_BITS    = 8;
+        const size_t RADIX_BUCKETS = 1 << RADIX_BITS;
+        const size_t RADIX_PASSES  = sizeof(ui64) * 8 / RADIX_BITS;
+
+        /**
+         * @brief Converts a float to an unsigned integer with the same ordering, such that
+         * comparing the integers is equivalent to comparing the floats.
+         *
+         * Positive floats just need their sign bit flipping to sit above the negatives, while
+         * negative floats need all their bits flipping as their magnitude grows with their
+         * integer representation.
+         *
+         * @param value The float to convert.
+         *
+         * @return The integer representation of the float with the same ordering.
+         */
+        inline ui32 floatToOrderedBits(f32 value) {
+            ui32 bits;
+            std::memcpy(&bits, &value, sizeof(ui32));
+
+            ui32 mask = static_cast<ui32>(-static_cast<i32>(bits >> 31)) | 0x80000000;
+            return bits ^ mask;
+        }
+
+        /**
+         * @brief Sorts the given keys in ascending order, moving the associated indices with them.
+         * The sort is stable, so equal keys keep the order they were given in.
+         *
+         * Each pass sorts by one byte of the key, starting with the least significant. Passes in
+         * which every key has the same byte are skipped, so keys using only their lower bytes
+         * (e.g. a 32-bit texture ID) cost no more than they need to.
+         *
+         * @param keys The keys to sort, these are sorted in place.
+         * @param indices The indices associated with each key, these are reordered with the keys.
+         * @param keysScratch A buffer of at least count keys used while sorting.
+         * @param indicesScratch A buffer of at least count indices used while sorting.
+         * @param count The number of keys to sort.
+         */
+        inline void radixSort(ui64* keys, ui32* indices, ui64* keysScratch, ui32* indicesScratch, size_t count) {
+            if (count < 2) return;
+
+            // Build the histograms of every byte of the keys in one go.
+            size_t histograms[RADIX_PASSES][RADIX_BUCKETS] = {};
+            for (size_t i = 0; i < count; ++i) {
+                ui64 key = keys[i];
+                for (size_t pass = 0; pass < RADIX_PASSES; ++pass) {
+                    ++histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)];
+                }
+            }
+
+            ui64* srcKeys    = keys;
+            ui32* srcIndices = indices;
+            ui64* dstKeys    = keysScratch;
+            ui32* dstIndices = indicesScratch;
+            for (size_t pass = 0; pass < RADIX_PASSES; ++pass) {
+                size_t* histogram = histograms[pass];
+                size_t  shift     = pass * RADIX_BITS;
+
+                // If every key has the same value for this byte, this pass would change nothing.
+                if (histogram[(srcKeys[0] >> shift) & (RADIX_BUCKETS - 1)] == count) continue;
+
+                // Turn the histogram into the offset at which each bucket starts.
+                size_t offset = 0;
+                for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+                    size_t bucketCount = histogram[bucket];
+                    histogram[bucket]  = offset;
+                    offset            += bucketCount;
+                }
+
+                // Scatter keys into their buckets, in order, so that the sort remains stable.
+                for (size_t i = 0; i < count; ++i) {
+                    size_t position = histogram[(srcKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+
+                    dstKeys[position]    = srcKeys[i];
+                    dstIndices[position] = srcIndices[i];
+                }
+
+                std::swap(srcKeys,    dstKeys);
+                std::swap(srcIndices, dstIndices);
+            }
+
+            // If we finished with the sorted data in the scratch buffers, copy it back.
+            if (srcKeys != keys) {
+                std::memcpy(keys,    srcKeys,    count * sizeof(ui64));
+                std::memcpy(indices, srcIndices, count * sizeof(ui32));
+            }
+        }
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !SP_Graphics_RadixSort_h__
@@ -0,0 +1,77 @@
+/**
+ * @file RenderDevice.h
+ * @brief Provides an interface for devices that sprite batchers may render through in place of OpenGL.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_RenderDevice_h__)
+#define SP_Graphics_RenderDevice_h__
+
+#include "types.h"
+#include "graphics/ClipStack.h"
+#include "graphics/SpriteBatcher.h"
+
+namespace SecretProject {
+    namespace graphics {
+        /**
+         * @brief The data a render device is given to render a frame of sprites - exactly
+         * what a sprite batcher would otherwise send to the GPU.
+         *
+         * Each sprite is a quad of four vertices, built by the sprite's QuadBuilder, in the
+         * order top left, top right, bottom left, bottom right. Each batch draws the sprites
+         * from its sprite offset with its zeroth texture.
+         */
+        struct RenderFrame {
+            f32m4               worldProjection;
+            f32m4               viewProjection;
+            const SpriteVertex* vertices;
+            const SpriteBatch*  batches;
+            size_t              batchCount;
+            const ClipStack*    clipStack;
+        };
+
+        /**
+         * @brief Provides an interface for rendering sprites other than through OpenGL -
+         * e.g. with a software rasteriser so that rendering can be tested and measured
+         * headlessly.
+         *
+         * Textures drawn with are created through the device, which gives out IDs in
+         * place of OpenGL texture names.
+         */
+        class RenderDevice {
+        public:
+            virtual ~RenderDevice() { /* Empty */ }
+
+            /**
+             * @brief Creates a texture from the given pixels.
+             *
+             * @param dimensions The dimensions of the texture.
+             * @param pixels The pixels of the texture, as tightly packed RGBA bytes,
+             * starting with the top row.
+             *
+             * @return The ID of the created texture.
+             */
+            virtual GLuint createTexture(ui32v2 dimensions, const void* pixels) = 0;
+            /**
+             * @brief Destroys the texture of the given ID.
+             *
+             * @param texture The ID of the texture to destroy.
+             */
+            virtual void destroyTexture(GLuint texture) = 0;
+
+            /**
+             * @brief Renders the given frame.
+             *
+             * Opaque batches are expected to be rendered first, without blending, and all
+             * other batches then blended over them, just as SpriteBatcher::render does.
+             *
+             * @param frame The frame to render.
+             */
+            virtual void render(const RenderFrame& frame) = 0;
+        };
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_RenderDevice_h__)
@@ -0,0 +1,121 @@
+/**
+ * @file SoftwareRenderDevice.h
+ * @brief Provides a render device that rasterises sprites on the CPU into an RGBA buffer.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_SoftwareRenderDevice_h__)
+#define SP_Graphics_SoftwareRenderDevice_h__
+
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+#include "graphics/RenderDevice.h"
+
+namespace SecretProject {
+    namespace graphics {
+        /**
+         * @brief Provides a render device that rasterises sprites on the CPU into its own
+         * colour and depth buffers, such that frames can be rendered, measured and compared
+         * without a GPU.
+         *
+         * Rasterisation follows OpenGL's rules as used by our default shaders closely enough
+         * to compare against: pixel centres are sampled, shared edges are only drawn once,
+         * fragments pass the depth test if nearer than what is there (GL_LESS), textures are
+         * sampled nearest with repeating, and blending is GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA.
+         * Attributes are interpolated linearly in screen space, which is exact for the
+         * orthographic projections sprites are rendered with.
+         */
+        class SoftwareRenderDevice : public RenderDevice {
+        public:
+            SoftwareRenderDevice();
+            virtual ~SoftwareRenderDevice() { /* Empty */ }
+
+            /**
+             * @brief Initialises the device, creating colour and depth buffers of the
+             * given dimensions. The buffers are cleared to opaque black and full depth.
+             *
+             * @param dimensions The dimensions of the buffers, i.e. the viewport.
+             */
+            void init(ui32v2 dimensions);
+            /**
+             * @brief Disposes of the device, its buffers and all textures.
+             */
+            void dispose();
+
+            /**
+             * @brief Clears the colour and depth buffers.
+             *
+             * @param colour The colour to clear to.
+             * @param depth The depth to clear to.
+             */
+            void clear(colour4 colour = { 0, 0, 0, 255 }, f32 depth = 1.0f);
+
+            virtual GLuint createTexture(ui32v2 dimensions, const void* pixels) override;
+            virtual void   destroyTexture(GLuint texture) override;
+
+            virtual void render(const RenderFrame& frame) override;
+
+            /**
+             * @brief Saves the colour buffer as a PNG.
+             *
+             * @param filepath The filepath to save to.
+             *
+             * @return True if the image was saved, false otherwise.
+             */
+            bool save(const char* filepath) const;
+
+            /**
+             * @return The colour buffer, as RGBA pixels starting with the top row.
+             */
+            const colour4* getPixels()     const { return m_colour.data(); }
+            ui32v2         getDimensions() const { return m_dimensions;    }
+        protected:
+            /**
+             * @brief A texture's dimensions and texels, top row first.
+             */
+            struct Texture {
+                ui32v2               dimensions;
+                std::vector<colour4> texels;
+            };
+
+            /**
+             * @brief A vertex after being taken through to window coordinates, with the
+             * attributes the fragment stage needs.
+             */
+            struct RasterVertex {
+                f32v2 position;
+                f32   depth;
+                f32v2 relativePosition;
+                f32v4 colour;
+            };
+
+            /**
+             * @brief Rasterises a triangle of a sprite's quad.
+             *
+             * @param a The first vertex of the triangle.
+             * @param b The second vertex of the triangle.
+             * @param c The third vertex of the triangle.
+             * @param uvDimensions The UV coordinates & size of the sprite's texture.
+             * @param texture The texture of the sprite.
+             * @param scissor The area of the window to draw within, as (left, bottom,
+             * right, top), with right and top exclusive.
+             * @param blend Whether to blend with the colour buffer or overwrite it.
+             */
+            void drawTriangle(RasterVertex a, RasterVertex b, RasterVertex c, const f32v4& uvDimensions,
+                                const Texture& texture, const i32v4& scissor, bool blend);
+
+            ui32v2               m_dimensions;
+            std::vector<colour4> m_colour;
+            std::vector<f32>     m_depth;
+
+            std::unordered_map<GLuint, Texture> m_textures;
+            GLuint                              m_nextTexture;
+        };
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_SoftwareRenderDevice_h__)
@@ -8,18 +8,37 @@
 #if !defined(SP_Graphics_SpriteBatcher_h__)
 #define SP_Graphics_SpriteBatcher_h__
 
+#include <array>
+#include <atomic>
+#include <limits>
 #include <map>
+#include <unordered_set>
 #include <vector>
 
 #include "types.h"
+#include "debug/Profiler.h"
+#include "graphics/ClipStack.h"
 #include "graphics/Font.h"
+#include "graphics/FrameArena.h"
 #include "graphics/GLSLProgram.h"
 #include "graphics/Gradients.hpp"
+#include "graphics/StreamingBuffer.h"
 #include "graphics/TextAlign.h"
+#include "graphics/TextLayout.h"
+#include "graphics/TextureArraySet.h"
 #include "graphics/WordWrap.hpp"
+#include "threading/WorkerPool.h"
 
 namespace SecretProject {
     namespace graphics {
+        class RenderDevice;
+        class SpriteLayer;
+
+        // The most draw contexts that may be acquired from a sprite batcher in one batching phase.
+        const ui32 MAX_DRAW_CONTEXTS = 32;
+        // The most textures a batch may bind at once, in multi-unit texture mode.
+        const ui32 MAX_BATCH_TEXTURES = 16;
+
         // Forward declarations.
         struct Sprite;
         struct SpriteVertex;
@@ -30,11 +49,93 @@ namespace SecretProject {
 
         /**
          * @brief The sorting modes allowed for sorting sprites.
+         *
+         * TEXTURE sorts by clip rectangle and then texture, so that sprites
+         *     sharing both end up in the same batch.
+         * TEXTURE_THEN_DEPTH sorts by texture and then, within each texture,
+         *     front to back - this generates as few batches as TEXTURE while
+         *     still letting the depth test reject hidden fragments early.
+         * OPAQUE_THEN_TRANSLUCENT puts opaque sprites first, front to back, which
+         *     are then rendered with blending disabled, followed by translucent
+         *     sprites, back to front. A sprite is opaque if its colours are and
+         *     its texture has been marked opaque (see setTextureOpaque).
          */
         enum class SpriteSortMode {
             BACK_TO_FRONT,
             FRONT_TO_BACK,
-            TEXTURE
+            TEXTURE,
+            TEXTURE_THEN_DEPTH,
+            OPAQUE_THEN_TRANSLUCENT
+        };
+
+        /**
+         * @brief The modes by which sprite data may be uploaded to the GPU.
+         *
+         * ORPHAN builds vertices in a CPU-side buffer, orphans the GPU buffer and then
+         *     copies the vertices over. This is the simplest, and works well for sprites
+         *     that rarely change.
+         *
+         * STREAMING builds vertices directly into a triple-buffered ring of GPU memory,
+         *     guarded by fences. This avoids both the extra copy and any implicit sync
+         *     with the driver, and so is best for sprites that change every frame.
+         */
+        enum class SpriteUploadMode {
+            ORPHAN,
+            STREAMING
+        };
+
+        /**
+         * @brief The modes by which sprites may be rendered.
+         *
+         * QUADS expands each sprite into four SpriteVertex records plus six indices, via
+         *     the sprite's QuadBuilder.
+         *
+         * INSTANCED sends one SpriteInstance record per sprite and expands it into a quad
+         *     in the vertex shader, cutting the data sent to the GPU per sprite by more
+         *     than four times. Note that in this mode a sprite's QuadBuilder is ignored.
+         */
+        enum class SpriteRenderMode {
+            QUADS,
+            INSTANCED
+        };
+
+        /**
+         * @brief The modes by which sprites' textures are bound when rendering.
+         *
+         * SINGLE binds one texture per batch, starting a new batch whenever the
+         *     texture changes between consecutive sprites.
+         *
+         * ARRAY allows textures to be registered into texture arrays of textures of
+         *     the same size. Sprites using any texture within the same array share a
+         *     batch, each picking its texture by a per-vertex layer index - so runs of
+         *     mixed textures (e.g. from depth sorting) are drawn with one draw call.
+         *
+         * MULTI_UNIT binds up to MAX_BATCH_TEXTURES textures (or as many as there are
+         *     texture units) to consecutive texture units per batch, each sprite picking
+         *     its texture by a per-vertex slot index. This needs no up front work with
+         *     textures, and keeps batches few without reordering sprites.
+         */
+        enum class SpriteTextureMode {
+            SINGLE,
+            ARRAY,
+            MULTI_UNIT
+        };
+
+        /**
+         * @brief The formats of vertex that sprites may be built into in quads render
+         * mode (instanced render mode has its own format).
+         *
+         * STANDARD sends each vertex as a SpriteVertex, as built by the sprite's
+         *     QuadBuilder.
+         *
+         * COMPACT packs each built SpriteVertex into a 24-byte CompactSpriteVertex,
+         *     less than half the size. The final texture coordinates of each vertex are
+         *     computed on the CPU and quantised to 16 bits, so UVs must lie within
+         *     [0, 1] - i.e. textures cannot be repeated across a sprite.
+         */
+        enum class SpriteVertexFormat {
+            STANDARD,
+            COMPACT
         };
 
         /**
@@ -49,6 +150,7 @@ namespace SecretProject {
             f32v4       uvDimensions;
             colour4     c1, c2;
             Gradient    gradient;
+            ui32        clipIndex; // Index of the clip rectangle current when drawn, or NO_CLIP.
             // TODO(Matthew): Offsets, rotations, etc?
             // TODO(Matthew): Custom gradients? Different blending styles?
         };
@@ -59,9 +161,13 @@ namespace SecretProject {
          * that are consecutively positioned within the SpriteBatcher.
          */
         struct SpriteBatch {
-            GLuint texture;
-            ui32   indexCount;
-            ui32   indexOffset;
+            GLenum                                 textureTarget;
+            ui32                                   textureCount;
+            std::array<GLuint, MAX_BATCH_TEXTURES> textures;
+            ui32                                   spriteCount;
+            ui32                                   spriteOffset;
+            ui32                                   clipIndex;
+            bool                                   opaque;
         };
 
         /**
@@ -73,6 +179,61 @@ namespace SecretProject {
             f32v2   relativePosition;
             f32v4   uvDimensions;
             colour4 colour;
+            i32     textureIndex;
+        };
+
+        /**
+         * @brief The properties of a vertex of a sprite in compact vertex format. Rather
+         * than a relative position and UV dimensions, each vertex carries its final
+         * texture coordinates as normalised 16-bit integers.
+         */
+        struct CompactSpriteVertex {
+            f32v3   position;
+            ui16v2  textureCoords;
+            colour4 colour;
+            i16     textureIndex;
+            ui16    padding;
+        };
+
+        /**
+         * @brief The properties of an instance of a sprite. In instanced render
+         * mode, this is all we send to the GPU per sprite - the vertex shader
+         * builds the quad from it.
+         */
+        struct SpriteInstance {
+            f32v2   position;
+            f32v2   size;
+            f32     depth;
+            f32v4   uvDimensions;
+            colour4 c1, c2;
+            ui32    gradient;
+            i32     textureIndex;
+        };
+
+        /**
+         * @brief Counters describing the last frame of a sprite batcher, reset when a
+         * batching phase begins, filled in by end and added to by render.
+         *
+         * Submitted sprites include those drawn to draw contexts. Uploads count bytes
+         * sent to the GPU, including those of layers uploaded by render. A
+         * reallocation is the batcher's vertex buffer being given storage of a new
+         * size, or the shared quad index buffer being regenerated - which only happens
+         * when it is first acquired or grown. Times are in nanoseconds, of the
+         * batching phase only. With a render device nothing is uploaded, drawn or
+         * bound through OpenGL, so those counters stay zero.
+         */
+        struct SpriteBatcherStats {
+            ui32 spritesSubmitted;
+            ui32 spritesCulled;
+            ui32 batches;
+            ui32 drawCalls;
+            ui32 textureBinds;
+            ui64 vertexBytesUploaded;
+            ui64 indexBytesUploaded;
+            ui32 bufferReallocations;
+            ui64 sortTime;
+            ui64 buildTime;
+            ui64 uploadTime;
         };
 
         /**
@@ -85,19 +246,157 @@ namespace SecretProject {
             RELATIVE_POSITION,
             UV_DIMENSIONS,
             COLOUR,
+            TEXTURE_INDEX,
             SpriteShaderAttribID_SENTINEL
         };
 
+        /**
+         * @brief A set of shader attribute IDs we use for setting and linking
+         * variables in our compact shaders to the data we send to the GPU. (Note
+         * how they correspond to the CompactSpriteVertex properties.)
+         */
+        enum CompactSpriteShaderAttribID : GLuint {
+            COMPACT_POSITION = 0,
+            COMPACT_TEXTURE_COORDS,
+            COMPACT_COLOUR,
+            COMPACT_TEXTURE_INDEX,
+            CompactSpriteShaderAttribID_SENTINEL
+        };
+
+        /**
+         * @brief A set of shader attribute IDs we use for setting and linking
+         * variables in our instanced shaders to the data we send to the GPU. (Note
+         * how they correspond to the SpriteInstance properties.)
+         */
+        enum SpriteInstanceShaderAttribID : GLuint {
+            INSTANCE_POSITION = 0,
+            INSTANCE_SIZE,
+            INSTANCE_DEPTH,
+            INSTANCE_UV_DIMENSIONS,
+            INSTANCE_COLOUR_1,
+            INSTANCE_COLOUR_2,
+            INSTANCE_GRADIENT,
+            INSTANCE_TEXTURE_INDEX,
+            SpriteInstanceShaderAttribID_SENTINEL
+        };
+
         /**
          * @brief Implementation of sprite batching, sprites are drawn after
          * the sprite batch phase begins, after the end of which they are sorted
          * and their vertex data is collated and sent to the GPU ready for rendering.
          */
         class SpriteBatcher {
+            friend class SpriteLayer;
+
             using Sprites    = std::vector<Sprite>;
             using SpritePtrs = std::vector<Sprite*>;
-            using Batches    = std::vector<SpriteBatch>;
+            using Batches        = std::vector<SpriteBatch>;
+            using TextureIndices = std::vector<i32>;
         public:
+            /**
+             * @brief Provides a place for a single thread to draw sprites to during a
+             * batching phase, without contending with any other thread. The sprites
+             * drawn to each context are merged into the sprite batcher in end.
+             *
+             * A context must only be used by the thread that acquired it, and only
+             * between the begin and end of the phase it was acquired in. Strings may
+             * only be drawn with a font instance, as fetching fonts from the font cache
+             * is not thread safe. For the same reason, strings drawn to a context are
+             * laid out afresh rather than taken from the sprite batcher's layout cache.
+             */
+            class DrawContext {
+                friend class SpriteBatcher;
+            public:
+                DrawContext() : m_defaultTexture(0) { /* Empty */ }
+
+                /**
+                 * @brief Clips sprites drawn after this call to the given rectangle.
+                 *
+                 * See SpriteBatcher::pushClipRect for details.
+                 */
+                void pushClipRect(const f32v4& rect) { m_clipStack.push(rect); }
+                /**
+                 * @brief Stops clipping to the most recently pushed clip rectangle.
+                 */
+                void popClipRect() { m_clipStack.pop(); }
+
+                /**
+                 * @brief Gets the context's arena for allocations that need last no
+                 * longer than the batching phase. It is reset when the next phase begins.
+                 */
+                FrameArena& getFrameArena() { return m_frameArena; }
+
+                /**
+                 * @brief Draw the sprite given.
+                 *
+                 * @param The sprite to draw.
+                 */
+                void draw(Sprite&& sprite);
+                /**
+                 * @brief Draw a sprite with the given properties.
+                 *
+                 * See SpriteBatcher::draw for details of each parameter.
+                 */
+                void draw( QuadBuilder builder,
+                                GLuint texture,
+                          const f32v2& position,
+                          const f32v2& size,
+                               colour4 c1       = { 255, 255, 255, 255 },
+                               colour4 c2       = { 255, 255, 255, 255 },
+                              Gradient gradient = Gradient::NONE,
+                                   f32 depth    = 0.0f,
+                          const f32v4& uvRect   = f32v4(0.0f, 0.0f, 1.0f, 1.0f));
+                /**
+                 * @brief Draw a sprite with the given properties.
+                 *
+                 * See SpriteBatcher::draw for details of each parameter.
+                 */
+                void draw(      GLuint texture,
+                          const f32v2& position,
+                          const f32v2& size,
+                               colour4 c1       = { 255, 255, 255, 255 },
+                               colour4 c2       = { 255, 255, 255, 255 },
+                              Gradient gradient = Gradient::NONE,
+                                   f32 depth    = 0.0f,
+                          const f32v4& uvRect   = f32v4(0.0f, 0.0f, 1.0f, 1.0f));
+
+                /**
+                 * @brief Draw a string with the given properties.
+                 *
+                 * See SpriteBatcher::drawString for details of each parameter.
+                 */
+                void drawString( const char* str,
+                                       f32v4 rect,
+                                StringSizing sizing,
+                                     colour4 tint,
+                                FontInstance fontInstance,
+                                   TextAlign align = TextAlign::TOP_LEFT,
+                                    WordWrap wrap  = WordWrap::NONE,
+                                         f32 depth = 0.0f);
+                /**
+                 * @brief Draw a string with the given properties.
+                 *
+                 * See SpriteBatcher::drawString for details of each parameter.
+                 */
+                void drawString(const StringComponents& components,
+                                                 f32v4 rect,
+                                             TextAlign align = TextAlign::TOP_LEFT,
+                                              WordWrap wrap  = WordWrap::NONE,
+                                                   f32 depth = 0.0f);
+                /**
+                 * @brief Draw a string that has already been laid out.
+                 *
+                 * See SpriteBatcher::drawLayout for details of each parameter.
+                 */
+                void drawLayout(const TextLayout& layout, const f32v2& offset = f32v2(0.0f), f32 depth = 0.0f);
+            protected:
+                std::vector<Sprite> m_sprites;
+                GLuint              m_defaultTexture;
+                ClipStack           m_clipStack;
+                FrameArena          m_frameArena;
+                TextLayout          m_textLayout; // Laid out into afresh for each string drawn.
+            };
+
             SpriteBatcher();
             ~SpriteBatcher();
 
@@ -110,9 +409,36 @@ namespace SecretProject {
              * drawing.
              * @param usageHint The usage hint we give to OpenGL, telling it how often
              * we expect the sprites to change. Choosing the right value here can
-             * improve performance.
+             * improve performance. Ignored in streaming upload mode.
+             * @param uploadMode The mode by which sprite data is uploaded to the GPU.
+             * @param renderMode The mode by which sprites are rendered.
+             * @param textureMode The mode by which sprites' textures are bound.
+             * @param vertexFormat The format of vertex sprites are built into. Ignored
+             * in instanced render mode.
+             */
+            void init(         FontCache* fontCache,
+                                   GLenum usageHint    = GL_STATIC_DRAW,
+                         SpriteUploadMode uploadMode   = SpriteUploadMode::ORPHAN,
+                         SpriteRenderMode renderMode   = SpriteRenderMode::QUADS,
+                        SpriteTextureMode textureMode  = SpriteTextureMode::SINGLE,
+                       SpriteVertexFormat vertexFormat = SpriteVertexFormat::STANDARD);
+            /**
+             * @brief Initialises the sprite batcher to render through the given render
+             * device rather than OpenGL, e.g. to render headlessly with a software
+             * render device. Sprites are built as standard quads, and no OpenGL calls
+             * are made by the sprite batcher.
+             *
+             * Only textures created through the device may be drawn with. Layers,
+             * texture arrays, multiple texture units and shaders are not available,
+             * and strings can only be drawn with fonts whose textures came from the
+             * device.
+             *
+             * @param fontCache The font cache to use for obtaining fonts for string
+             * drawing.
+             * @param device The device to render through. The device is not owned by
+             * the sprite batcher and must outlive its use here.
              */
-            void init(FontCache* fontCache, GLenum usageHint = GL_STATIC_DRAW);
+            void init(FontCache* fontCache, RenderDevice* device);
             /**
              * @brief Disposes of the sprite batcher.
              */
@@ -124,12 +450,101 @@ namespace SecretProject {
              */
             void reserve(size_t count);
 
+            /**
+             * @brief Sets the worker pool used to build sprites in parallel during
+             * end. The pool is not owned by the sprite batcher and must outlive its
+             * use here.
+             *
+             * @param workerPool The worker pool to use, or nullptr to build sprites
+             * on the calling thread only.
+             */
+            void setWorkerPool(spthread::WorkerPool* workerPool) { m_workerPool = workerPool; }
+
+            /**
+             * @brief Sets the rectangle outside of which sprites are culled during end,
+             * before they are sorted or built. This only applies to sprites drawn for
+             * each batching phase - the sprites of layers are never culled.
+             *
+             * @param rect The rectangle to cull to, in the same coordinates sprites are
+             * drawn in, as (x, y, width, height).
+             */
+            void setCullRect(const f32v4& rect) { m_culling = true; m_cullRect = rect; }
+            /**
+             * @brief Sets the cull rectangle to the area of the world visible when
+             * rendering with the given world projection and screen size.
+             *
+             * @param worldProjection The projection matrix to go from world coords to
+             * "camera" coords.
+             * @param screenSize The size of the screen.
+             */
+            void setCullRect(const f32m4& worldProjection, const f32v2& screenSize);
+            /**
+             * @brief Stops culling sprites, so that all sprites drawn are rendered.
+             */
+            void clearCullRect() { m_culling = false; }
+
+            /**
+             * @brief Marks the given texture as opaque (i.e. every texel has full alpha)
+             * or not. Sprites are only ever treated as opaque if their texture has been
+             * marked so, as we can't cheaply inspect a texture's contents. The default
+             * texture is always opaque.
+             *
+             * @param texture The texture to mark.
+             * @param opaque Whether the texture is opaque.
+             */
+            void setTextureOpaque(GLuint texture, bool opaque = true);
+
+            /**
+             * @brief Registers the given texture into the texture array of textures of
+             * its size, after which sprites using it may share batches with sprites
+             * using any other texture in the same array. Only available in array
+             * texture mode.
+             *
+             * Register textures before drawing with them, and only once the texture's
+             * contents are final - the texture is copied when registered.
+             *
+             * @param texture The texture to register.
+             *
+             * @return True if the texture was registered, false otherwise.
+             */
+            bool registerArrayTexture(GLuint texture);
+
             /**
              * @brief Begins the sprite batching phase. Call this BEFORE ANY call to a
              * "draw" function!
              */
             void begin();
 
+            /**
+             * @brief Acquires a draw context that the calling thread may draw sprites to
+             * concurrently with other threads until the next call to end. Acquiring a
+             * context is lock free, and may be done from any thread once begin has been
+             * called.
+             *
+             * @return The acquired draw context, or nullptr if MAX_DRAW_CONTEXTS have
+             * already been acquired in this batching phase.
+             */
+            DrawContext* acquireDrawContext();
+
+            /**
+             * @brief Clips sprites drawn after this call to the given rectangle, until
+             * the matching call to popClipRect. Clip rectangles nest, each being kept
+             * within the one pushed before it.
+             *
+             * Clipping is done by the GPU with a scissor rectangle when rendering, so
+             * sprites are drawn whole and no time is spent clipping them on the CPU.
+             * Sprites are batched by clip rectangle, so prefer pushing a rectangle once
+             * around everything it applies to.
+             *
+             * @param rect The rectangle to clip to, in the same coordinates sprites are
+             * drawn in, as (x, y, width, height).
+             */
+            void pushClipRect(const f32v4& rect) { m_clipStack.push(rect); }
+            /**
+             * @brief Stops clipping to the most recently pushed clip rectangle.
+             */
+            void popClipRect() { m_clipStack.pop(); }
+
             /**
              * @brief Draw the sprite given.
              *
@@ -271,6 +686,9 @@ namespace SecretProject {
              * enabling multiple components, each its own sub-string possessing
              * its own properties.
              *
+             * Layouts are cached, so drawing a string just as it was drawn recently
+             * skips laying it out again.
+             *
              * @param components The components of the string, consisting of
              *                   sub-strings and their properties.
              * @param rect The rectangle in which to draw the string.
@@ -278,20 +696,128 @@ namespace SecretProject {
              * @param wrap The wrapping mode to use for the string.
              * @param depth The depth of the string for rendering.
              */
-            void drawString(StringComponents components,
-                                       f32v4 rect,
-                                   TextAlign align = TextAlign::TOP_LEFT,
-                                    WordWrap wrap  = WordWrap::NONE,
-                                         f32 depth = 0.0f);
+            void drawString(const StringComponents& components,
+                                             f32v4 rect,
+                                         TextAlign align = TextAlign::TOP_LEFT,
+                                          WordWrap wrap  = WordWrap::NONE,
+                                               f32 depth = 0.0f);
+            /**
+             * @brief Draw a string that has already been laid out, e.g. by
+             * layoutString.
+             *
+             * @param layout The layout of the string.
+             * @param offset The offset to draw the string at from where it was laid
+             * out, which moves its clip rectangle with it.
+             * @param depth The depth of the string for rendering.
+             */
+            void drawLayout(const TextLayout& layout, const f32v2& offset = f32v2(0.0f), f32 depth = 0.0f);
 
             /**
-             * @brief Ends the sprite batching phase, the sprites are sorted and
-             * the batches are generated, sending the vertex buffers to the GPU. Call
-             * this AFTER ALL calls to "draw" functions and BEFORE ANY call to a
-             * "render" function.
+             * @brief Lays out a string with the given properties, without drawing it.
+             * The layout gives where each line breaks, each line's length and height,
+             * the size of the whole string, and where each glyph is to be drawn, and may
+             * be drawn any number of times with drawLayout.
+             *
+             * @param str The string to lay out.
+             * @param rect The rectangle in which to lay out the string.
+             * @param sizing The sizing of the font.
+             * @param tint The colour to give the string.
+             * @param fontInstance The instance of the font to use.
+             * @param align The alignment to use for the string.
+             * @param wrap The wrapping mode to use for the string.
+             * @param layout The layout to populate, any existing contents are cleared.
+             */
+            void layoutString( const char* str,
+                                     f32v4 rect,
+                              StringSizing sizing,
+                                   colour4 tint,
+                              FontInstance fontInstance,
+                                 TextAlign align,
+                                  WordWrap wrap,
+                                TextLayout& layout);
+            /**
+             * @brief Lays out a string of the given components, without drawing it.
+             *
+             * See the single string version for details.
+             *
+             * @param components The components of the string, consisting of
+             *                   sub-strings and their properties.
+             * @param rect The rectangle in which to lay out the string.
+             * @param align The alignment to use for the string.
+             * @param wrap The wrapping mode to use for the string.
+             * @param layout The layout to populate, any existing contents are cleared.
+             */
+            void layoutString(const StringComponents& components,
+                                               f32v4 rect,
+                                           TextAlign align,
+                                            WordWrap wrap,
+                                          TextLayout& layout);
+
+            /**
+             * @brief Measures the size a string with the given properties would be
+             * drawn at - the length of its longest line, and the height of all its
+             * lines together.
+             *
+             * The measurement is laid out through the layout cache, so measuring the
+             * same string again costs no more layout. To both measure a string and
+             * draw it, lay it out once with layoutString and draw that with
+             * drawLayout instead.
+             *
+             * @param str The string to measure.
+             * @param sizing The sizing of the font.
+             * @param fontInstance The instance of the font to use.
+             * @param maxWidth The widest a line may be before it is wrapped.
+             * @param wrap The wrapping mode to use for the string.
+             *
+             * @return The size of the string.
+             */
+            f32v2 measureString( const char* str,
+                                StringSizing sizing,
+                                FontInstance fontInstance,
+                                         f32 maxWidth = std::numeric_limits<f32>::max(),
+                                    WordWrap wrap     = WordWrap::NONE);
+            /**
+             * @brief Measures the size a string of the given components would be drawn
+             * at.
+             *
+             * See the single string version for details.
+             *
+             * @param components The components of the string, consisting of
+             *                   sub-strings and their properties.
+             * @param maxWidth The widest a line may be before it is wrapped.
+             * @param wrap The wrapping mode to use for the string.
+             *
+             * @return The size of the string.
+             */
+            f32v2 measureString(const StringComponents& components,
+                                                    f32 maxWidth = std::numeric_limits<f32>::max(),
+                                               WordWrap wrap     = WordWrap::NONE);
+
+            /**
+             * @brief Ends the sprite batching phase, the sprites drawn to any draw
+             * contexts are merged in, any sprites outside the cull rectangle are
+             * dropped, the remaining sprites are sorted and the batches are
+             * generated, sending the vertex buffers to the GPU. Call this AFTER ALL
+             * calls to "draw" functions (including on draw contexts) and BEFORE ANY
+             * call to a "render" function.
              */
             void end(SpriteSortMode sortMode = SpriteSortMode::TEXTURE);
 
+            /**
+             * @brief Adds a layer to be rendered by the sprite batcher. Layers are
+             * rendered in the order they are added, before the sprites drawn to the
+             * sprite batcher itself. The layer is not owned by the sprite batcher.
+             *
+             * @param layer The layer to add.
+             */
+            void addLayer(SpriteLayer* layer);
+            /**
+             * @brief Removes a layer from those rendered by the sprite batcher.
+             *
+             * @param layer The layer to remove.
+             */
+            void removeLayer(SpriteLayer* layer);
+
             // TODO(Matthew): Do we want to allow a shader per batch? I don't think so,
             //                but unsure.
             /**
@@ -299,6 +825,10 @@ namespace SecretProject {
              * that is passed in is unlinked, it is assumed the attributes are to be
              * set as the defaults and so they are set as such and the shader linked.
              *
+             * Note that in instanced render mode, the shader must take its attributes
+             * from SpriteInstance rather than SpriteVertex, and in compact vertex format
+             * from CompactSpriteVertex.
+             *
              * @param shader The shader to use. If this is nullptr, then the default
              * shader is set as the active shader.
              *
@@ -307,7 +837,9 @@ namespace SecretProject {
             bool setShader(GLSLProgram* shader = nullptr);
 
             /**
-             * @brief Render the batches that have been generated.
+             * @brief Render the batches that have been generated, after those of any
+             * layers added. Layers that have changed are uploaded first. Opaque batches
+             * of both are rendered before anything else, with blending disabled.
              *
              * @param worldProjection The projection matrix to go from world coords to
              * "camera" coords.
@@ -337,63 +869,246 @@ namespace SecretProject {
              * @param screenSize The size of the screen.
              */
             void render(const f32v2& screenSize);
+
+            /**
+             * @brief Gets the counters of the last frame, i.e. of the batching phase
+             * last ended and any renders of it since.
+             */
+            const SpriteBatcherStats& getStats() const { return m_stats; }
+
+            /**
+             * @brief Gets the sprite batcher's arena for allocations that need last no
+             * longer than the batching phase, such as those made laying out strings.
+             * It is reset when the next phase begins.
+             */
+            FrameArena& getFrameArena() { return m_frameArena; }
+
+            /**
+             * @brief Forgets all cached string layouts. This must be called if a font
+             * instance that strings have been drawn with is disposed of.
+             */
+            void clearTextLayoutCache() { m_textLayoutCache.clear(); }
         protected:
             /**
-             * @brief Sorts the sprites using the given sort mode.
+             * @brief Sets the default attribute locations on the given shader, for
+             * the render mode of the sprite batcher.
+             *
+             * @param shader The shader to set the attributes of.
+             */
+            void setShaderAttributes(GLSLProgram* shader);
+            /**
+             * @brief Connects the vertex attributes of our shaders to the layout of
+             * SpriteVertex (or SpriteInstance in instanced render mode) as stored in
+             * the currently bound vertex buffer. Our vertex array must be bound.
+             *
+             * @param offset The offset in bytes into the buffer of the first vertex
+             * or instance.
+             */
+            void setVertexAttribPointers(size_t offset);
+
+            /**
+             * @brief Gets the texture a sprite with the given texture is batched by -
+             * the texture array holding it in array texture mode, otherwise the texture
+             * itself.
+             *
+             * @param texture The texture of the sprite.
+             * @param layer Set to the layer of the texture in its texture array, or -1.
+             *
+             * @return The texture to batch the sprite by.
+             */
+            GLuint getBatchTexture(GLuint texture, i32& layer) const {
+                if (m_textureMode != SpriteTextureMode::ARRAY) {
+                    layer = -1;
+                    return texture;
+                }
+                return m_textureArrays.resolve(texture, layer);
+            }
+
+            /**
+             * @brief Determines if the given sprite is opaque - i.e. its colours have
+             * full alpha and its texture has been marked opaque.
+             *
+             * @param sprite The sprite to classify.
+             *
+             * @return True if the sprite is opaque, false otherwise.
+             */
+            bool isOpaque(const Sprite& sprite) const {
+                bool opaque = sprite.c1.a == 255 && (sprite.gradient == Gradient::NONE || sprite.c2.a == 255);
+                return opaque && m_opaqueTextures.count(sprite.texture) != 0;
+            }
+
+            /**
+             * @brief Binds the textures of the given batch - a texture array to the
+             * first texture slot, or otherwise each texture to consecutive slots from
+             * the zeroth. Each texture bound is counted in the frame's stats.
+             *
+             * @param batch The batch whose textures to bind.
+             */
+            void bindBatchTexture(const SpriteBatch& batch);
+            /**
+             * @brief Sets the scissor rectangle to cover the given clip rectangle as
+             * seen on screen, or disables the scissor test if the sprites are not
+             * clipped.
+             *
+             * @param clipStack The clip stack the clip index refers into.
+             * @param clipIndex The index of the clip rectangle to apply.
+             */
+            void applyClipRect(const ClipStack& clipStack, ui32 clipIndex);
+            /**
+             * @brief Renders the given batches from the given buffer. The vertex
+             * array to render with and the shader must already be bound.
+             *
+             * @param batches The batches to render.
+             * @param clipStack The clip stack the batches' clip indices refer into.
+             * @param vbo The buffer the batches' sprites were built into.
+             * @param bufferOffset The offset in bytes into the buffer of the first
+             * sprite.
+             * @param opaque Whether to render the opaque batches, or the rest.
+             */
+            void renderBatches(const Batches& batches, const ClipStack& clipStack, GLuint vbo, size_t bufferOffset, bool opaque);
+            /**
+             * @brief Adds to the frame's stats any uploads of the shared quad index
+             * buffer made since they were last counted.
+             */
+            void countIndexUploads();
+
+            /**
+             * @brief Removes from the given sprites any that lie entirely outside the
+             * cull rectangle, keeping the rest in the order they were drawn.
+             *
+             * @param sprites The sprites to cull.
+             */
+            void cullSprites(Sprites& sprites);
+
+            /**
+             * @brief Sorts the sprites using the given sort mode, populating the
+             * sprite pointers in sorted order.
+             *
+             * Rather than comparing sprites directly, we build a compact key for
+             * each sprite and radix sort those keys along with the index of their
+             * sprite - avoiding chasing pointers into the sprites while sorting.
              *
              * @param sortMode The mode by which to sort the sprites.
+             * @param sprites The sprites to sort.
+             * @param spritePtrs The pointers to populate with the sorted sprites.
              */
-            void sortSprites(SpriteSortMode sortMode);
+            void sortSprites(SpriteSortMode sortMode, Sprites& sprites, SpritePtrs& spritePtrs);
 
             /**
              * @brief Generates batches from the drawn sprites.
              */
             void generateBatches();
-
             /**
-             * @brief Compares sprites by texture ID for sorting (such that all sprites
-             * with the same texture will be in one batch together - this is the
-             * quickest for rendering by generating the least batches).
+             * @brief Computes the batches of the given sorted sprites - i.e. where
+             * each run of sprites sharing a texture (or a set of textures, in
+             * multi-unit texture mode) begins and ends.
              *
-             * @param sprite1 The first sprite to compare.
-             * @param sprite2 The second sprite to compare.
+             * @param sortMode The mode the sprites were sorted by.
+             * @param spritePtrs The sorted sprites.
+             * @param batches The batches to populate, any existing batches are
+             * cleared.
+             * @param textureIndices Populated with the index of each sorted
+             * sprite's texture within its batch - its layer in array texture mode,
+             * or its slot in multi-unit texture mode.
              */
-            static bool sortTexture(Sprite* sprite1, Sprite* sprite2)     { return sprite1->texture < sprite2->texture; }
+            void computeBatches(SpriteSortMode sortMode, const SpritePtrs& spritePtrs, Batches& batches, TextureIndices& textureIndices);
             /**
-             * @brief Compares sprites by depth for sorting (such that sprites
-             * with less depth are ordered first).
+             * @brief Builds all the given sorted sprites into the given buffer,
+             * across the worker pool if we have one and there are enough sprites.
              *
-             * @param sprite1 The first sprite to compare.
-             * @param sprite2 The second sprite to compare.
+             * @param spritePtrs The sorted sprites.
+             * @param textureIndices The texture index of each sorted sprite.
+             * @param data The buffer to build the sprites into.
              */
-            static bool sortFrontToBack(Sprite* sprite1, Sprite* sprite2) { return sprite1->depth   < sprite2->depth;   }
+            void buildAllSprites(const SpritePtrs& spritePtrs, const TextureIndices& textureIndices, ui8* data);
             /**
-             * @brief Compares sprites by depth for sorting (such that sprites
-             * with greater depth are ordered first).
+             * @brief Builds the given sprites into the given buffer, as quads or
+             * instances depending on render mode. Each sprite is written to its own
+             * slot, so distinct runs of sprites may be built concurrently.
              *
-             * @param sprite1 The first sprite to compare.
-             * @param sprite2 The second sprite to compare.
+             * @param sprites The sprites to build.
+             * @param textureIndices The texture index of each sprite.
+             * @param data The buffer to build the sprites into.
+             * @param count The number of sprites to build.
              */
-            static bool sortBackToFront(Sprite* sprite1, Sprite* sprite2) { return sprite1->depth   > sprite2->depth;   }
+            void buildSprites(Sprite* const* sprites, const i32* textureIndices, ui8* data, size_t count);
+            /**
+             * @brief Gets the number of bytes each sprite takes up in a vertex
+             * buffer in the current render mode.
+             *
+             * @return The number of bytes per sprite.
+             */
+            size_t getSpriteBytes() const;
 
             std::vector<Sprite>  m_sprites;
             std::vector<Sprite*> m_spritePtrs;
+            TextureIndices       m_textureIndices;
+
+            std::vector<ui64> m_sortKeys,    m_sortKeysScratch;
+            std::vector<ui32> m_sortIndices, m_sortIndicesScratch;
+
+            SpriteSortMode m_sortMode;
+
+            bool              m_culling;
+            f32v4             m_cullRect;
+            std::vector<ui32> m_cullIndices;
+
+            ClipStack m_clipStack;
+            f32m4     m_clipTransform;
+            i32v4     m_viewport;
+
+            FrameArena      m_frameArena;
+            TextLayoutCache m_textLayoutCache;
 
             GLuint m_vao, m_vbo, m_ibo;
             GLenum m_usageHint;
-            ui32   m_indexCount;
+
+            SpriteUploadMode   m_uploadMode;
+            SpriteRenderMode   m_renderMode;
+            SpriteTextureMode  m_textureMode;
+            ui32               m_maxBatchTextures;
+            SpriteVertexFormat m_vertexFormat;
+            StreamingBuffer    m_streamingBuffer;
+            size_t             m_bufferOffset;
+
+            TextureArraySet m_textureArrays;
+
+            spthread::WorkerPool* m_workerPool;
+
+            std::array<DrawContext, MAX_DRAW_CONTEXTS> m_drawContexts;
+            std::atomic<ui32>                          m_drawContextCount;
+
+            std::vector<SpriteLayer*> m_layers;
+
+            RenderDevice*    m_device;
+            std::vector<ui8> m_deviceVertices;
 
             ui32        m_defaultTexture;
             GLSLProgram m_defaultShader;
 
+            std::unordered_set<GLuint> m_opaqueTextures;
+
             GLSLProgram* m_activeShader;
 
             FontCache* m_fontCache;
 
             std::vector<SpriteBatch> m_batches;
+
+            SpriteBatcherStats m_stats;
+            size_t             m_vboSize;
+            ui64               m_indexBytesCounted;
+            ui32               m_indexGenerationsCounted;
+
+#if defined(SP_PROFILING)
+            spdebug::GPUTimer m_gpuTimer;
+#endif
         };
 
         void buildQuad(const Sprite* sprite, SpriteVertex* vertices);
+
+        void buildInstance(const Sprite* sprite, SpriteInstance* instance);
+
+        void compactQuad(const SpriteVertex* vertices, CompactSpriteVertex* compactVertices);
     }
 }
 namespace spg = SecretProject::graphics;
@@ -0,0 +1,149 @@
+/**
+ * @file SpriteLayer.h
+ * @brief Provides a retained layer of sprites, uploaded to the GPU only when changed.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_SpriteLayer_h__)
+#define SP_Graphics_SpriteLayer_h__
+
+#include "graphics/SpriteBatcher.h"
+
+namespace SecretProject {
+    namespace graphics {
+        // Identifies a sprite within a layer, valid until the layer is next begun.
+        using SpriteHandle = ui32;
+        const SpriteHandle NIL_SPRITE_HANDLE = static_cast<SpriteHandle>(-1);
+
+        /**
+         * @brief Provides a layer of sprites that is kept between frames, with its own
+         * vertex buffer and batches. Sprites are drawn to a layer between calls to its
+         * begin and end, just as to a draw context, after which the layer is sorted and
+         * marked dirty. A dirty layer is uploaded the next time its sprite batcher
+         * renders, and is otherwise drawn straight from the buffer already on the GPU.
+         *
+         * This suits sprites that rarely change, such as backgrounds and menus, which
+         * would otherwise be sorted and uploaded afresh every frame.
+         *
+         * Each sprite drawn to a layer is given a handle, in the order drawn, by which it
+         * may later be updated in place. Updates that keep the sprite in the same place in
+         * the sorted order only mark that sprite dirty, and on upload only the ranges of
+         * dirty sprites are rebuilt and sent to the GPU. Updates that would move the
+         * sprite (e.g. changing its texture) mark the whole layer dirty.
+         *
+         * The layer shares the shader, render mode and index buffer of the sprite
+         * batcher it is initialised with, and must be added to that sprite batcher to
+         * be rendered.
+         */
+        class SpriteLayer : public SpriteBatcher::DrawContext {
+            friend class SpriteBatcher;
+        public:
+            SpriteLayer();
+            ~SpriteLayer() { /* Empty */ }
+
+            /**
+             * @brief Initialises the layer, creating its vertex array and buffer.
+             *
+             * @param batcher The sprite batcher the layer will be rendered by. This must
+             * already be initialised.
+             */
+            void init(SpriteBatcher* batcher);
+            /**
+             * @brief Disposes of the layer, removing it from its sprite batcher.
+             */
+            void dispose();
+
+            /**
+             * @brief Begins rebuilding the layer, clearing all of its sprites. Call this
+             * BEFORE ANY call to a "draw" function!
+             */
+            void begin();
+            /**
+             * @brief Ends rebuilding the layer, the sprites are sorted and batched and
+             * the layer is marked dirty, to be uploaded when next rendered.
+             *
+             * @param sortMode The mode by which to sort the sprites.
+             */
+            void end(SpriteSortMode sortMode = SpriteSortMode::TEXTURE);
+
+            /**
+             * @brief Gets the handle that the next sprite drawn to the layer will be
+             * given. Handles are given out in the order sprites are drawn, so the handles
+             * of the sprites of, e.g., a string are those from the next handle before it
+             * was drawn up to the next handle after.
+             *
+             * @return The handle of the next sprite drawn.
+             */
+            SpriteHandle getNextHandle() const { return static_cast<SpriteHandle>(m_sprites.size()); }
+            /**
+             * @brief Gets the sprite with the given handle.
+             *
+             * @param handle The handle of the sprite.
+             *
+             * @return The sprite with the given handle.
+             */
+            const Sprite& getSprite(SpriteHandle handle) const { return m_sprites[handle]; }
+            /**
+             * @brief Updates the sprite with the given handle in place. Call this only
+             * after the layer has been ended.
+             *
+             * If the sprite keeps its place in the sorted order, only it is rebuilt and
+             * uploaded on the next render, otherwise the layer is sorted again and
+             * uploaded in full. The sprite keeps the clip rectangle it was drawn with.
+             *
+             * @param handle The handle of the sprite to update.
+             * @param sprite The new properties of the sprite.
+             */
+            void update(SpriteHandle handle, const Sprite& sprite);
+
+            /**
+             * @brief Marks the layer as needing to be uploaded again in full.
+             */
+            void markDirty() { m_dirty = true; }
+            bool isDirty() const { return m_dirty || !m_dirtySlots.empty(); }
+
+            size_t getSpriteCount() const { return m_sprites.size(); }
+        protected:
+            /**
+             * @brief Sorts and batches the layer's sprites, marking it dirty.
+             */
+            void sort();
+            /**
+             * @brief Builds the layer's sprites and uploads them to its vertex buffer,
+             * clearing the dirty flag. If only some sprites are dirty, only the ranges
+             * of those sprites are rebuilt and uploaded.
+             *
+             * @return The number of bytes uploaded.
+             */
+            size_t upload();
+            /**
+             * @brief Builds and uploads the sorted sprites in the range [begin, end).
+             *
+             * @param begin The first sorted position to upload.
+             * @param end One past the last sorted position to upload.
+             *
+             * @return The number of bytes uploaded.
+             */
+            size_t uploadRange(ui32 begin, ui32 end);
+
+            SpriteBatcher* m_batcher;
+
+            GLuint         m_vao, m_vbo;
+            bool           m_dirty;
+            SpriteSortMode m_sortMode;
+
+            std::vector<Sprite*>     m_spritePtrs;
+            std::vector<SpriteBatch> m_batches;
+            std::vector<i32>         m_textureIndices;
+
+            std::vector<ui32> m_slots;      // The sorted position of each sprite, indexed by handle.
+            std::vector<ui32> m_dirtySlots; // The sorted positions of sprites updated since the last upload.
+
+            std::vector<ui8> m_rangeData;
+        };
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_SpriteLayer_h__)
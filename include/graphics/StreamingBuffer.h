@@ -0,0 +1,112 @@
+/**
+ * @file StreamingBuffer.h
+ * @brief Provides a ring of buffer sections for streaming per-frame data to the GPU without stalling.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_StreamingBuffer_h__)
+#define SP_Graphics_StreamingBuffer_h__
+
+#include <vector>
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace graphics {
+        const ui32 DEFAULT_STREAMING_SECTIONS = 3;
+
+        /**
+         * @brief Provides a buffer split into a ring of equally sized sections, each of
+         * which is written to directly from the CPU in turn.
+         *
+         * Where GL_ARB_buffer_storage is supported, the buffer is mapped persistently
+         * once and left mapped - writes then go straight into GPU-visible memory with no
+         * further driver involvement. Otherwise each section is mapped unsynchronised as it
+         * is written to and unmapped immediately after.
+         *
+         * In either case, a fence is placed after the GPU is last told to read from a
+         * section, and we wait on that fence before the section is written to again. With
+         * three sections this wait is almost always already satisfied.
+         */
+        class StreamingBuffer {
+        public:
+            StreamingBuffer();
+            ~StreamingBuffer() { /* Empty */ }
+
+            /**
+             * @brief Initialises the streaming buffer. No GPU memory is allocated until the
+             * first call to map.
+             *
+             * @param target The target the buffer will be bound to (e.g. GL_ARRAY_BUFFER).
+             * @param sectionCount The number of sections in the ring.
+             */
+            void init(GLenum target, ui32 sectionCount = DEFAULT_STREAMING_SECTIONS);
+            /**
+             * @brief Disposes of the streaming buffer, unmapping and deleting the buffer and
+             * any outstanding fences.
+             */
+            void dispose();
+
+            /**
+             * @brief Advances to the next section of the ring and maps it for writing.
+             *
+             * If the sections are too small for the requested size, the buffer is recreated
+             * at a larger size - in which case, any state referencing the buffer (e.g. vertex
+             * attribute pointers) must be respecified.
+             *
+             * @param size The number of bytes to be written.
+             * @param recreated Set to true if the buffer was recreated, false otherwise.
+             *
+             * @return A pointer to the mapped section, or nullptr on failure.
+             */
+            void* map(size_t size, bool& recreated);
+            /**
+             * @brief Finishes writing to the current section.
+             */
+            void unmap();
+
+            /**
+             * @brief Places a fence guarding the current section. Call this after issuing
+             * any draw calls that read from the current section.
+             */
+            void fence();
+
+            GLuint getID()            const { return m_id;                           }
+            bool   isPersistent()     const { return m_persistent;                   }
+            size_t getSectionSize()   const { return m_sectionSize;                  }
+            size_t getCurrentOffset() const { return m_sectionSize * m_currentSection; }
+        protected:
+            /**
+             * @brief (Re)creates the buffer such that each section can contain at least the
+             * given number of bytes.
+             *
+             * @param sectionSize The minimum size of each section.
+             *
+             * @return True if the buffer was successfully created, false otherwise.
+             */
+            bool create(size_t sectionSize);
+            /**
+             * @brief Waits on the fence guarding the given section, if one exists, and then
+             * deletes that fence.
+             *
+             * @param section The index of the section to wait on.
+             */
+            void wait(ui32 section);
+
+            GLuint m_id;
+            GLenum m_target;
+            bool   m_persistent;
+            ui8*   m_mapped;
+
+            size_t m_sectionSize;
+            ui32   m_sectionCount;
+            ui32   m_currentSection;
+
+            std::vector<GLsync> m_fences;
+        };
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_StreamingBuffer_h__)
@@ -8,64 +8,216 @@
 #if !defined(SP_Graphics_StringDrawers_h__)
 #define SP_Graphics_StringDrawers_h__
 
+#include <limits>
+
+#include "debug/Profiler.h"
+#include "graphics/Clipping.hpp"
+#include "graphics/Font.h"
+#include "graphics/FrameArena.h"
+#include "graphics/Gradients.hpp"
+#include "graphics/TextAlign.h"
+#include "graphics/TextLayout.h"
+
 namespace SecretProject {
     namespace graphics {
         /**
          * @brief The data needed to draw a glyph.
          */
         struct DrawableGlyph {
-            Glyph*  glyph;
-            f32     xPos;
-            f32v2   scaling;
-            colour4 tint;
-            GLuint  texture;
+            const Glyph* glyph;
+            f32          xPos;
+            f32v2        scaling;
+            colour4      tint;
+            GLuint       texture;
         };
 
         /**
          * @brief The data needed to draw a line.
+         *
+         * Lines and their glyphs are allocated from the frame arena of whatever is
+         * being drawn to, so laying out a string makes no heap allocations.
          */
         struct DrawableLine {
             f32 length;
             f32 height;
-            std::vector<DrawableGlyph> drawables;
+            ArenaVector<DrawableGlyph> drawables;
         };
-        using DrawableLines = std::vector<DrawableLine>;
+        using DrawableLines = ArenaVector<DrawableLine>;
+
+        // The codepoint malformed UTF-8 is decoded as.
+        const char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+        // Marks that there is no character before the one being placed to kern against.
+        const char32_t NO_PREVIOUS_CHARACTER = 0xFFFFFFFF;
+
+        /**
+         * @brief Decodes the UTF-8 encoded codepoint at the given index of a string,
+         * advancing the index past it.
+         *
+         * Malformed sequences - stray continuation bytes, truncated or overlong encodings,
+         * surrogates and anything beyond U+10FFFF - are decoded as REPLACEMENT_CHARACTER,
+         * consuming only their first byte.
+         *
+         * @param str The string to decode from.
+         * @param index The index of the first byte of the codepoint, set to that of the next.
+         *
+         * @return The decoded codepoint.
+         */
+        inline char32_t decodeUTF8(const char* str, size_t& index) {
+            const ui8* bytes = reinterpret_cast<const ui8*>(str + index);
+
+            // ASCII is by far the most common, and is encoded as itself.
+            if (bytes[0] < 0x80) {
+                ++index;
+                return bytes[0];
+            }
+
+            // Otherwise the lead byte gives the length of the sequence, and the first bits of the codepoint.
+            size_t   length;
+            char32_t codepoint, minimum;
+            if ((bytes[0] & 0xE0) == 0xC0) {
+                length    = 2;
+                codepoint = bytes[0] & 0x1F;
+                minimum   = 0x80;
+            } else if ((bytes[0] & 0xF0) == 0xE0) {
+                length    = 3;
+                codepoint = bytes[0] & 0x0F;
+                minimum   = 0x800;
+            } else if ((bytes[0] & 0xF8) == 0xF0) {
+                length    = 4;
+                codepoint = bytes[0] & 0x07;
+                minimum   = 0x10000;
+            } else {
+                ++index;
+                return REPLACEMENT_CHARACTER;
+            }
+
+            // The null terminator isn't a continuation byte, so we never read past the end of the string.
+            for (size_t i = 1; i < length; ++i) {
+                if ((bytes[i] & 0xC0) != 0x80) {
+                    ++index;
+                    return REPLACEMENT_CHARACTER;
+                }
+
+                codepoint = (codepoint << 6) | (bytes[i] & 0x3F);
+            }
+
+            if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+                ++index;
+                return REPLACEMENT_CHARACTER;
+            }
+
+            index += length;
+            return codepoint;
+        }
+
+        /**
+         * @brief Gets the kerning, after scaling, between the given characters of a font instance.
+         *
+         * @param font The font instance of both characters.
+         * @param previous The character before, or NO_PREVIOUS_CHARACTER if there is none.
+         * @param character The character being placed.
+         * @param scaling The horizontal scaling of the glyphs.
+         *
+         * @return The offset to add to the pen position before placing the character's glyph.
+         */
+        inline f32 getKerning(const FontInstance& font, char32_t previous, char32_t character, f32 scaling) {
+            if (font.kerning == nullptr) return 0.0f;
+
+            // Kerning is only kept between printable ASCII characters, which also rules out there being no previous character.
+            char32_t first  = previous  - static_cast<char32_t>(FIRST_PRINTABLE_CHAR);
+            char32_t second = character - static_cast<char32_t>(FIRST_PRINTABLE_CHAR);
+            if (first >= KERNING_TABLE_WIDTH || second >= KERNING_TABLE_WIDTH) return 0.0f;
+
+            return static_cast<f32>(font.kerning[first * KERNING_TABLE_WIDTH + second]) * scaling;
+        }
+
+        /**
+         * @brief Places the glyphs of the given lines into the given layout, aligned
+         * within the given rectangle.
+         *
+         * @param lines The lines to place.
+         * @param totalHeight The height of all the lines together.
+         * @param rect The bounding rectangle the string must be kept within.
+         * @param align The alignment for the text.
+         * @param layout The layout to populate, any existing contents are cleared.
+         */
+        inline void finaliseLayout(const DrawableLines& lines, f32 totalHeight, f32v4 rect, TextAlign align, TextLayout& layout) {
+            layout.clear();
+            layout.rect = rect;
+
+            // Characters crossing the edge of the bounding rectangle are clipped by the GPU. Each clip
+            // rectangle splits batches, so we only clip from the first character that needs it.
+            bool clipping = false;
+
+            f32 currentY = 0.0f;
+            for (auto& line : lines) {
+                f32v2 offsets = calculateOffset(align, rect, totalHeight, line.length);
+
+                layout.lines.emplace_back(LayoutLine{
+                    static_cast<ui32>(layout.glyphs.size()),
+                    static_cast<ui32>(line.drawables.size()),
+                    line.length,
+                    line.height
+                });
+
+                for (auto& drawable : line.drawables) {
+                    f32v2 size     = drawable.glyph->size * drawable.scaling;
+                    f32v2 position = f32v2(drawable.xPos + drawable.glyph->bearing * drawable.scaling.x, currentY) + offsets + f32v2(rect.x, rect.y) + f32v2(0.0f, line.height - size.y);
+
+                    if (!clipping && !contains(rect, position, size)) {
+                        layout.firstClippedGlyph = static_cast<ui32>(layout.glyphs.size());
+                        clipping = true;
+                    }
+
+                    layout.glyphs.emplace_back(LayoutGlyph{ position, size, drawable.glyph->uvDimensions, drawable.tint, drawable.texture });
+                }
+
+                layout.size.x = std::max(layout.size.x, line.length);
+                currentY     += line.height;
+            }
+            layout.size.y = totalHeight;
+
+            if (!clipping) layout.firstClippedGlyph = static_cast<ui32>(layout.glyphs.size());
+        }
 
 
 
         /******************************************************\
-         * No Wrap Draw                                       *
+         * No Wrap Layout                                     *
         \******************************************************/
 
         /**
-         * @brief Draws a string with no wrapping.
+         * @brief Lays out a string with no wrapping.
          *
-         * @param batcher The sprite batcher to draw the string to.
-         * @param components The string components to draw.
+         * @param arena The arena to allocate lines from.
+         * @param components The string components to lay out.
+         * @param componentCount The number of string components.
          * @param rect The bounding rectangle the string must be kept within.
          * @param align The alignment for the text.
-         * @param depth The depth at which to render the string.
+         * @param layout The layout to populate.
          */
-        inline void drawNoWrapString(SpriteBatcher* batcher, StringComponents components, f32v4 rect, TextAlign align, f32 depth) {
+        inline void layoutNoWrapString(FrameArena* arena, const StringComponent* components, size_t componentCount, f32v4 rect, TextAlign align, TextLayout& layout) {
+            SP_PROFILE_ZONE("layoutNoWrapString");
+
             // We will populate these data points for drawing later.
-            DrawableLines lines;
+            DrawableLines lines(arena);
             f32 totalHeight = 0.0f;
 
             // Place the first line.
-            lines.emplace_back(DrawableLine{0.0f, 0.0f, std::vector<DrawableGlyph>()});
+            lines.emplace_back(DrawableLine{0.0f, 0.0f, ArenaVector<DrawableGlyph>(arena)});
 
             // TODO(Matthew): Can we make guesses as to the amount of drawables to reserve for a line? For amount of lines?
 
-            for (auto& component : components) {
+            for (size_t c = 0; c < componentCount; ++c) {
+                const StringComponent& component = components[c];
+
                 // Simplify property names.
                 const char*  str    = component.first;
                 FontInstance font   = component.second.fontInstance;
                 StringSizing sizing = component.second.sizing;
                 colour4      tint   = component.second.tint;
 
-                char start = font.owner->getStart();
-                char end   = font.owner->getEnd();
-
                 // Process sizing into a simple scale factor.
                 f32v2 scaling;
                 f32   height;
@@ -78,24 +230,27 @@ namespace SecretProject {
                     height = sizing.targetHeight;
                 }
 
+                // The glyph before the one being placed, for kerning.
+                char32_t previousCharacter = NO_PREVIOUS_CHARACTER;
+
                 // Gets set to true if we go out of the height of the rect.
                 bool verticalOverflow = false;
                 // Iterate over this component's string.
-                for (size_t i = 0; str[i] != '\0'; ++i) {
-                    char   character      = str[i];
-                    size_t characterIndex = static_cast<size_t>(character) - static_cast<size_t>(start);
+                for (size_t i = 0, next = 0; str[i] != '\0'; i = next) {
+                    char32_t character = decodeUTF8(str, next);
 
                     // If character is a new line character, add a new line and go to next character.
                     if (character == '\n') {
                         totalHeight += lines.back().height;
-                        lines.emplace_back(DrawableLine{ 0.0f, height, std::vector<DrawableGlyph>() });
+                        lines.emplace_back(DrawableLine{ 0.0f, height, ArenaVector<DrawableGlyph>(arena) });
 
+                        previousCharacter = NO_PREVIOUS_CHARACTER;
                         continue;
                     }
 
                     // If character is unsupported, skip.
-                    if (character < start || character > end ||
-                            !font.glyphs[characterIndex].supported) continue;
+                    const Glyph* glyph = font.glyphs->find(character);
+                    if (glyph == nullptr) continue;
 
                     // If the line's height is less than the height of this font instance, and we're about to add a
                     // glyph from this font instance, then the line's height needs setting to the font instances's.
@@ -108,12 +263,13 @@ namespace SecretProject {
                         lines.back().height = height;
                     }
 
-                    // Determine character width after scaling.
-                    f32 characterWidth = font.glyphs[characterIndex].size.x * scaling.x;
+                    // Kern against the glyph before, then add character to line for drawing at the pen position.
+                    f32 xPos = lines.back().length + getKerning(font, previousCharacter, character, scaling.x);
 
-                    // Add character to line for drawing.
-                    lines.back().drawables.emplace_back(DrawableGlyph{ &font.glyphs[characterIndex], lines.back().length, scaling, tint, font.texture });
-                    lines.back().length += characterWidth;
+                    lines.back().drawables.emplace_back(DrawableGlyph{ glyph, xPos, scaling, tint, font.texture });
+                    lines.back().length = xPos + glyph->advance * scaling.x;
+
+                    previousCharacter = character;
                 }
 
                 // If we have overflown vertically, break out of outer loop.
@@ -122,67 +278,46 @@ namespace SecretProject {
             // Update the total height for last line.
             totalHeight += lines.back().height;
 
-            f32 currentY = 0.0f;
-            for (auto& line : lines) {
-                f32v2 offsets = calculateOffset(align, rect, totalHeight, line.length);
-
-                for (auto& drawable : line.drawables) {
-                    f32v2 size         = drawable.glyph->size * drawable.scaling;
-                    f32v2 position     = f32v2(drawable.xPos, currentY) + offsets + f32v2(rect.x, rect.y) + f32v2(0.0f, line.height - size.y);
-                    f32v4 uvDimensions = drawable.glyph->uvDimensions;
-
-                    f32v2 oldSize = size;
-
-                    clip(rect, position, size, uvDimensions);
-
-                    // Reject any character that even slightly clips with the bounding rectangle.
-                    if (oldSize == size) {
-                        batcher->draw(drawable.texture, position, size, drawable.tint,
-                                        { 255, 255, 255, 255 }, Gradient::NONE, depth, uvDimensions);
-                    } else {
-                        continue;
-                    }
-                }
-
-                currentY += line.height;
-            }
+            finaliseLayout(lines, totalHeight, rect, align, layout);
         }
 
 
 
         /******************************************************\
-         * Quick Wrap Draw                                    *
+         * Quick Wrap Layout                                  *
         \******************************************************/
 
         /**
-         * @brief Draws a string with quick wrapping.
+         * @brief Lays out a string with quick wrapping.
          *
-         * @param batcher The sprite batcher to draw the string to.
-         * @param components The string components to draw.
+         * @param arena The arena to allocate lines from.
+         * @param components The string components to lay out.
+         * @param componentCount The number of string components.
          * @param rect The bounding rectangle the string must be kept within.
          * @param align The alignment for the text.
-         * @param depth The depth at which to render the string.
+         * @param layout The layout to populate.
          */
-        inline void drawQuickWrapString(SpriteBatcher* batcher, StringComponents components, f32v4 rect, TextAlign align, f32 depth) {
+        inline void layoutQuickWrapString(FrameArena* arena, const StringComponent* components, size_t componentCount, f32v4 rect, TextAlign align, TextLayout& layout) {
+            SP_PROFILE_ZONE("layoutQuickWrapString");
+
             // We will populate these data points for drawing later.
-            DrawableLines lines;
+            DrawableLines lines(arena);
             f32 totalHeight = 0.0f;
 
             // Place the first line.
-            lines.emplace_back(DrawableLine{0.0f, 0.0f, std::vector<DrawableGlyph>()});
+            lines.emplace_back(DrawableLine{0.0f, 0.0f, ArenaVector<DrawableGlyph>(arena)});
 
             // TODO(Matthew): Can we make guesses as to the amount of drawables to reserve for a line? For amount of lines?
 
-            for (auto& component : components) {
+            for (size_t c = 0; c < componentCount; ++c) {
+                const StringComponent& component = components[c];
+
                 // Simplify property names.
                 const char*  str    = component.first;
                 FontInstance font   = component.second.fontInstance;
                 StringSizing sizing = component.second.sizing;
                 colour4      tint   = component.second.tint;
 
-                char start = font.owner->getStart();
-                char end   = font.owner->getEnd();
-
                 // Process sizing into a simple scale factor.
                 f32v2 scaling;
                 f32   height;
@@ -196,47 +331,52 @@ namespace SecretProject {
                 }
 
                 // auto hyphenate = [&]() {
-                //     char   hyphen = '-';
-                //     size_t index  = static_cast<size_t>(hyphen) - static_cast<size_t>(start);
+                //     const Glyph* hyphen = font.glyphs->find('-');
 
-                //     f32 characterWidth = font.glyphs[index].size.x * scaling.x;
+                //     f32 characterWidth = hyphen->advance * scaling.x;
 
-                //     lines.back().drawables.emplace_back(DrawableGlyph{ &font.glyphs[index], lines.back().length, scaling, tint, font.texture });
+                //     lines.back().drawables.emplace_back(DrawableGlyph{ hyphen, lines.back().length, scaling, tint, font.texture });
                 //     lines.back().length += characterWidth;
                 // };
 
+                // The glyph before the one being placed on the same line, for kerning.
+                char32_t previousCharacter = NO_PREVIOUS_CHARACTER;
+
                 // Gets set to true if we go out of the height of the rect.
                 bool verticalOverflow = false;
                 // Iterate over this component's string.
-                for (size_t i = 0; str[i] != '\0'; ++i) {
-                    char   character      = str[i];
-                    size_t characterIndex = static_cast<size_t>(character) - static_cast<size_t>(start);
+                for (size_t i = 0, next = 0; str[i] != '\0'; i = next) {
+                    char32_t character = decodeUTF8(str, next);
 
                     // If character is a new line character, add a new line and go to next character.
                     if (character == '\n') {
                         totalHeight += lines.back().height;
-                        lines.emplace_back(DrawableLine{ 0.0f, height, std::vector<DrawableGlyph>() });
+                        lines.emplace_back(DrawableLine{ 0.0f, height, ArenaVector<DrawableGlyph>(arena) });
 
+                        previousCharacter = NO_PREVIOUS_CHARACTER;
                         continue;
                     }
 
                     // If character is unsupported, skip.
-                    if (character < start || character > end ||
-                            !font.glyphs[characterIndex].supported) continue;
+                    const Glyph* glyph = font.glyphs->find(character);
+                    if (glyph == nullptr) continue;
 
-                    // Determine character width after scaling.
-                    f32 characterWidth = font.glyphs[characterIndex].size.x * scaling.x;
+                    // Determine where the character goes after kerning, and how far it advances the pen after scaling.
+                    f32 xPos           = lines.back().length + getKerning(font, previousCharacter, character, scaling.x);
+                    f32 characterWidth = glyph->advance * scaling.x;
 
                     // Given we are about to add a character, make sure it fits on the line, if not, make
                     // a new line and if the about-to-be-added character isn't a whitespace revisit it.
-                    if (lines.back().length + characterWidth > rect.z) {
+                    if (xPos + characterWidth > rect.z) {
                         totalHeight += lines.back().height;
-                        lines.emplace_back(DrawableLine{ 0.0f, height, std::vector<DrawableGlyph>() });
+                        lines.emplace_back(DrawableLine{ 0.0f, height, ArenaVector<DrawableGlyph>(arena) });
+
+                        previousCharacter = NO_PREVIOUS_CHARACTER;
 
                         // Make sure to revisit this character if not whitespace.
                         if (character != ' ') {
                             // hyphenate();
-                            --i;
+                            next = i;
                         }
                         continue;
                     }
@@ -253,8 +393,10 @@ namespace SecretProject {
                     }
 
                     // Add character to line for drawing.
-                    lines.back().drawables.emplace_back(DrawableGlyph{ &font.glyphs[characterIndex], lines.back().length, scaling, tint, font.texture });
-                    lines.back().length += characterWidth;
+                    lines.back().drawables.emplace_back(DrawableGlyph{ glyph, xPos, scaling, tint, font.texture });
+                    lines.back().length = xPos + characterWidth;
+
+                    previousCharacter = character;
                 }
 
                 // If we have overflown vertically, break out of outer loop.
@@ -263,67 +405,46 @@ namespace SecretProject {
             // Update the total height for last line.
             totalHeight += lines.back().height;
 
-            f32 currentY = 0.0f;
-            for (auto& line : lines) {
-                f32v2 offsets = calculateOffset(align, rect, totalHeight, line.length);
-
-                for (auto& drawable : line.drawables) {
-                    f32v2 size         = drawable.glyph->size * drawable.scaling;
-                    f32v2 position     = f32v2(drawable.xPos, currentY) + offsets + f32v2(rect.x, rect.y) + f32v2(0.0f, line.height - size.y);
-                    f32v4 uvDimensions = drawable.glyph->uvDimensions;
-
-                    f32v2 oldSize = size;
-
-                    clip(rect, position, size, uvDimensions);
-
-                    // Reject any character that even slightly clips with the bounding rectangle.
-                    if (oldSize == size) {
-                        batcher->draw(drawable.texture, position, size, drawable.tint,
-                                        { 255, 255, 255, 255 }, Gradient::NONE, depth, uvDimensions);
-                    } else {
-                        continue;
-                    }
-                }
-
-                currentY += line.height;
-            }
+            finaliseLayout(lines, totalHeight, rect, align, layout);
         }
 
 
 
         /******************************************************\
-         * Greedy Wrap Draw                                   *
+         * Greedy Wrap Layout                                 *
         \******************************************************/
 
         /**
-         * @brief Draws a string with greedy wrapping.
+         * @brief Lays out a string with greedy wrapping.
          *
-         * @param batcher The sprite batcher to draw the string to.
-         * @param components The string components to draw.
+         * @param arena The arena to allocate lines from.
+         * @param components The string components to lay out.
+         * @param componentCount The number of string components.
          * @param rect The bounding rectangle the string must be kept within.
          * @param align The alignment for the text.
-         * @param depth The depth at which to render the string.
+         * @param layout The layout to populate.
          */
-        inline void drawGreedyWrapString(SpriteBatcher* batcher, StringComponents components, f32v4 rect, TextAlign align, f32 depth) {
+        inline void layoutGreedyWrapString(FrameArena* arena, const StringComponent* components, size_t componentCount, f32v4 rect, TextAlign align, TextLayout& layout) {
+            SP_PROFILE_ZONE("layoutGreedyWrapString");
+
             // We will populate these data points for drawing later.
-            DrawableLines lines;
+            DrawableLines lines(arena);
             f32 totalHeight = 0.0f;
 
             // Place the first line.
-            lines.emplace_back(DrawableLine{0.0f, 0.0f, std::vector<DrawableGlyph>()});
+            lines.emplace_back(DrawableLine{0.0f, 0.0f, ArenaVector<DrawableGlyph>(arena)});
 
             // TODO(Matthew): Can we make guesses as to the amount of drawables to reserve for a line? For amount of lines?
 
-            for (auto& component : components) {
+            for (size_t c = 0; c < componentCount; ++c) {
+                const StringComponent& component = components[c];
+
                 // Simplify property names.
                 const char*  str    = component.first;
                 FontInstance font   = component.second.fontInstance;
                 StringSizing sizing = component.second.sizing;
                 colour4      tint   = component.second.tint;
 
-                char start = font.owner->getStart();
-                char end   = font.owner->getEnd();
-
                 // Process sizing into a simple scale factor.
                 f32v2 scaling;
                 f32   height;
@@ -338,25 +459,35 @@ namespace SecretProject {
 
                 // We have to do per-word lookahead before adding any characters to the lines, these data points
                 // enable us to do this.
-                ui32 beginIndex   = 0;
-                ui32 currentIndex = 0;
+                size_t beginIndex   = 0;
+                size_t currentIndex = 0;
                 f32  wordLength   = 0.0f;
 
+                // The glyph before the one being looked ahead at, and the last glyph flushed to the line, for kerning.
+                char32_t previousCharacter = NO_PREVIOUS_CHARACTER;
+                char32_t flushedCharacter  = NO_PREVIOUS_CHARACTER;
+
                 // Useful functor to flush current word to line.
                 auto flushWordToLine = [&]() {
                     while (beginIndex != currentIndex) {
                         // Get glyph index of character at string index.
-                        char   character      = str[beginIndex];
-                        size_t characterIndex = static_cast<size_t>(character) - static_cast<size_t>(start);
+                        char32_t character = decodeUTF8(str, beginIndex);
+
+                        // Unsupported characters were skipped over when looking ahead, so skip them here too.
+                        const Glyph* glyph = font.glyphs->find(character);
+                        if (glyph == nullptr) continue;
+
+                        // Kern against the glyph before, unless this starts the line.
+                        if (lines.back().drawables.empty()) flushedCharacter = NO_PREVIOUS_CHARACTER;
+                        f32 xPos = lines.back().length + getKerning(font, flushedCharacter, character, scaling.x);
 
                         // Add character to line for drawing.
-                        lines.back().drawables.emplace_back(DrawableGlyph{ &font.glyphs[characterIndex], lines.back().length, scaling, tint, font.texture });
+                        lines.back().drawables.emplace_back(DrawableGlyph{ glyph, xPos, scaling, tint, font.texture });
 
-                        // Determine character width after scaling & add to line length.
-                        f32 characterWidth = font.glyphs[characterIndex].size.x * scaling.x;
-                        lines.back().length += characterWidth;
+                        // Determine how far the character advances the pen after scaling & update line length.
+                        lines.back().length = xPos + glyph->advance * scaling.x;
 
-                        ++beginIndex;
+                        flushedCharacter = character;
                     }
 
                     // Reset word length.
@@ -366,9 +497,8 @@ namespace SecretProject {
                 // Gets set to true if we go out of the height of the rect.
                 bool verticalOverflow = false;
                 // Iterate over this component's string.
-                for (; str[currentIndex] != '\0'; ++currentIndex) {
-                    char   character      = str[currentIndex];
-                    size_t characterIndex = static_cast<size_t>(character) - static_cast<size_t>(start);
+                for (size_t next = currentIndex; str[currentIndex] != '\0'; currentIndex = next) {
+                    char32_t character = decodeUTF8(str, next);
 
                     // If character is a new line character, add a new line and go to next character.
                     if (character == '\n') {
@@ -376,17 +506,20 @@ namespace SecretProject {
                         flushWordToLine();
 
                         totalHeight += lines.back().height;
-                        lines.emplace_back(DrawableLine{ 0.0f, height, std::vector<DrawableGlyph>() });
+                        lines.emplace_back(DrawableLine{ 0.0f, height, ArenaVector<DrawableGlyph>(arena) });
 
+                        previousCharacter = NO_PREVIOUS_CHARACTER;
                         continue;
                     }
 
                     // If character is unsupported, skip.
-                    if (character < start || character > end ||
-                            !font.glyphs[characterIndex].supported) continue;
+                    const Glyph* glyph = font.glyphs->find(character);
+                    if (glyph == nullptr) continue;
 
-                    // Determine character width after scaling.
-                    f32 characterWidth = font.glyphs[characterIndex].size.x * scaling.x;
+                    // Determine how far the character advances the pen after kerning and scaling.
+                    f32 characterWidth = getKerning(font, previousCharacter, character, scaling.x)
+                                            + glyph->advance * scaling.x;
+                    previousCharacter = character;
 
                     // For characters on which we may break a line, flush the word so far
                     // prematurely so that the breakable character can be handled correctly.
@@ -398,7 +531,7 @@ namespace SecretProject {
                     // a new line and if the about-to-be-added character isn't a whitespace revisit it.
                     if (lines.back().length + wordLength + characterWidth > rect.z) {
                         totalHeight += lines.back().height;
-                        lines.emplace_back(DrawableLine{ 0.0f, height, std::vector<DrawableGlyph>() });
+                        lines.emplace_back(DrawableLine{ 0.0f, height, ArenaVector<DrawableGlyph>(arena) });
 
                         // Skip whitespace at start of new line.
                         if (str[beginIndex] == ' ') {
@@ -430,40 +563,25 @@ namespace SecretProject {
             // Update the total height for last line.
             totalHeight += lines.back().height;
 
-            f32 currentY = 0.0f;
-            for (auto& line : lines) {
-                f32v2 offsets = calculateOffset(align, rect, totalHeight, line.length);
-
-                for (auto& drawable : line.drawables) {
-                    f32v2 size         = drawable.glyph->size * drawable.scaling;
-                    f32v2 position     = f32v2(drawable.xPos, currentY) + offsets + f32v2(rect.x, rect.y) + f32v2(0.0f, line.height - size.y);
-                    f32v4 uvDimensions = drawable.glyph->uvDimensions;
-
-                    f32v2 oldSize = size;
-
-                    clip(rect, position, size, uvDimensions);
-
-                    // Reject any character that even slightly clips with the bounding rectangle.
-                    if (oldSize == size) {
-                        batcher->draw(drawable.texture, position, size, drawable.tint,
-                                        { 255, 255, 255, 255 }, Gradient::NONE, depth, uvDimensions);
-                    } else {
-                        continue;
-                    }
-                }
-
-                currentY += line.height;
-            }
+            finaliseLayout(lines, totalHeight, rect, align, layout);
         }
 
 
 
         /******************************************************\
-         * Minimum Raggedness Wrap Draw                       *
+         * Minimum Raggedness Wrap Layout                     *
         \******************************************************/
 
+        // How much more steeply a line's cost grows with overflow than with slack. A word wider than the rectangle
+        // forces a line to overflow, but any other arrangement is preferred over one that overflows.
+        const f64 MIN_RAG_OVERFLOW_PENALTY = 1000.0;
+
         /**
          * @brief Data needed for each word in a text.
+         *
+         * Start and end are the range of the word's glyphs amongst those of its text, and
+         * length the width of those glyphs. Newline marks the first word after a forced
+         * break, and hyphen a word broken after a hyphen rather than a space.
          */
         struct Word {
             ui64 start   : 31;
@@ -474,273 +592,336 @@ namespace SecretProject {
         };
 
         /**
-         * @brief Draws a string with greedy wrapping.
+         * @brief Calculates the raggedness of a line of the given length - the square of the
+         * space left at its end, or a far steeper square of how far it overflows.
+         *
+         * As this is convex in the length of the line, the cost of setting words i through j
+         * on one line satisfies the quadrangle inequality, which is what lets the breaks be
+         * found without trying every pair of words.
+         */
+        inline f64 calculateRaggedness(f64 length, f64 width) {
+            f64 slack = width - length;
+
+            return slack >= 0.0 ? slack * slack : slack * slack * MIN_RAG_OVERFLOW_PENALTY;
+        }
+
+        /**
+         * @brief Finds the breaks between words that minimise the summed raggedness of every
+         * line but the last, which costs nothing unless it overflows.
+         *
+         * This is the least weight subsequence problem, solved in O(n log n) with a queue
+         * of candidate line starts: a later candidate that beats an earlier one for some
+         * line end beats it for all later ends too, so each candidate owns a contiguous
+         * range of line ends, found by binary search when it is added.
+         *
+         * @param arena The arena to allocate working memory from.
+         * @param starts The offset at which each word starts, non-decreasing.
+         * @param ends The offset at which each word ends, non-decreasing.
+         * @param wordCount The number of words.
+         * @param width The width lines should be kept within.
+         * @param lineStarts Populated with the index of the first word of each line, in order.
+         */
+        inline void findMinRagBreaks(FrameArena* arena, const f32* starts, const f32* ends, ui32 wordCount, f32 width, ArenaVector<ui32>& lineStarts) {
+            lineStarts.clear();
+            if (wordCount == 0) return;
+
+            // costs[j] is the least cost of laying out words [0, j) given that a line starts at word j, and
+            // previous[j] where the line before starts in that layout.
+            ArenaVector<f64>  costs(wordCount, 0.0, arena);
+            ArenaVector<ui32> previous(wordCount, 0, arena);
+
+            // The queue of candidate line starts, each with the first line end it is the best for.
+            ArenaVector<ui32> candidates(wordCount, 0, arena);
+            ArenaVector<ui32> owns(wordCount, 0, arena);
+            ui32 head = 0, tail = 0;
+
+            // The cost of laying out words [0, j) with the last line starting at word i.
+            auto costVia = [&](ui32 i, ui32 j) {
+                return costs[i] + calculateRaggedness(static_cast<f64>(ends[j - 1]) - static_cast<f64>(starts[i]), width);
+            };
+
+            candidates[tail] = 0;
+            owns[tail++]     = 1;
+            for (ui32 j = 1; j < wordCount; ++j) {
+                // Drop the front candidate once the next has taken over.
+                while (tail - head > 1 && owns[head + 1] <= j) ++head;
+
+                costs[j]    = costVia(candidates[head], j);
+                previous[j] = candidates[head];
+
+                // Word j is now a candidate line start for later line ends, drop any candidate it beats across
+                // the whole of that candidate's range.
+                while (tail > head) {
+                    ui32 from = std::max(owns[tail - 1], j + 1);
+                    if (from >= wordCount || costVia(j, from) > costVia(candidates[tail - 1], from)) break;
+
+                    --tail;
+                }
+
+                if (tail == head) {
+                    if (j + 1 < wordCount) {
+                        candidates[tail] = j;
+                        owns[tail++]     = j + 1;
+                    }
+                    continue;
+                }
+
+                // Otherwise search for where j starts beating the last candidate, if anywhere.
+                ui32 low  = std::max(owns[tail - 1], j + 1) + 1;
+                ui32 high = wordCount;
+                while (low < high) {
+                    ui32 mid = low + (high - low) / 2;
+                    if (costVia(j, mid) <= costVia(candidates[tail - 1], mid)) {
+                        high = mid;
+                    } else {
+                        low = mid + 1;
+                    }
+                }
+
+                if (low < wordCount) {
+                    candidates[tail] = j;
+                    owns[tail++]     = low;
+                }
+            }
+
+            // The last line is free unless it overflows, so choose its start separately.
+            ui32 lastStart = 0;
+            f64  leastCost = std::numeric_limits<f64>::max();
+            for (ui32 i = 0; i < wordCount; ++i) {
+                f64 length = static_cast<f64>(ends[wordCount - 1]) - static_cast<f64>(starts[i]);
+                f64 cost   = costs[i] + (length > width ? calculateRaggedness(length, width) : 0.0);
+
+                if (cost < leastCost) {
+                    leastCost = cost;
+                    lastStart = i;
+                }
+            }
+
+            // Walk back through the chosen breaks, then put them in order.
+            for (ui32 i = lastStart; i != 0; i = previous[i]) {
+                lineStarts.push_back(i);
+            }
+            lineStarts.push_back(0);
+
+            std::reverse(lineStarts.begin(), lineStarts.end());
+        }
+
+        /**
+         * @brief Lays out a string with minimum raggedness wrapping.
+         *
+         * The string is first split into words, and each paragraph between forced breaks
+         * is then broken into lines so as to minimise the sum of the squares of the space
+         * left at the end of each line but the last.
          *
-         * @param batcher The sprite batcher to draw the string to.
-         * @param components The string components to draw.
+         * @param arena The arena to allocate lines and working memory from.
+         * @param components The string components to lay out.
+         * @param componentCount The number of string components.
          * @param rect The bounding rectangle the string must be kept within.
          * @param align The alignment for the text.
+         * @param layout The layout to populate.
+         */
+        inline void layoutMinRagWrapString(FrameArena* arena, const StringComponent* components, size_t componentCount, f32v4 rect, TextAlign align, TextLayout& layout) {
+            SP_PROFILE_ZONE("layoutMinRagWrapString");
+
+            /**
+             * @brief A run of words between forced breaks, along with the height of the font
+             * the break forcing it was made in.
+             */
+            struct Paragraph {
+                ui32 firstWord;
+                ui32 wordCount;
+                f32  height;
+            };
+
+            // Every glyph of the string, each positioned from the start of its paragraph, along with its height.
+            ArenaVector<DrawableGlyph> glyphs(arena);
+            ArenaVector<f32>           heights(arena);
+            // Every word of the string, and where each starts and ends from the start of its paragraph.
+            ArenaVector<Word>          words(arena);
+            ArenaVector<f32>           starts(arena);
+            ArenaVector<f32>           ends(arena);
+            ArenaVector<Paragraph>     paragraphs(arena);
+
+            paragraphs.emplace_back(Paragraph{ 0, 0, 0.0f });
+
+            f32  xPos      = 0.0f;
+            f32  wordStart = 0.0f;
+            bool inWord    = false;
+
+            // Useful functor to end the current word, if we are in one.
+            auto endWord = [&](bool hyphen) {
+                if (!inWord) return;
+
+                Word& word  = words.back();
+                word.end    = glyphs.size();
+                word.hyphen = hyphen ? 1 : 0;
+                word.length = xPos - wordStart;
+
+                starts.push_back(wordStart);
+                ends.push_back(xPos);
+
+                ++paragraphs.back().wordCount;
+                inWord = false;
+            };
+
+            for (size_t c = 0; c < componentCount; ++c) {
+                const StringComponent& component = components[c];
+
+                // Simplify property names.
+                const char*  str    = component.first;
+                FontInstance font   = component.second.fontInstance;
+                StringSizing sizing = component.second.sizing;
+                colour4      tint   = component.second.tint;
+
+                // Process sizing into a simple scale factor.
+                f32v2 scaling;
+                f32   height;
+                if (sizing.kind == StringSizingKind::SCALED) {
+                    scaling = sizing.scaling;
+                    height  = static_cast<f32>(font.height) * scaling.y;
+                } else {
+                    scaling.x = sizing.scaleX;
+                    scaling.y = sizing.targetHeight / static_cast<f32>(font.height);
+                    height    = sizing.targetHeight;
+                }
+
+                // The glyph before the one being placed, for kerning.
+                char32_t previousCharacter = NO_PREVIOUS_CHARACTER;
+
+                // Split this component's string into words, a word may carry on into the next component.
+                for (size_t i = 0, next = 0; str[i] != '\0'; i = next) {
+                    char32_t character = decodeUTF8(str, next);
+
+                    // If character is a new line character, end the paragraph.
+                    if (character == '\n') {
+                        endWord(false);
+
+                        paragraphs.emplace_back(Paragraph{ static_cast<ui32>(words.size()), 0, height });
+                        xPos = 0.0f;
+
+                        previousCharacter = NO_PREVIOUS_CHARACTER;
+                        continue;
+                    }
+
+                    // If character is unsupported, skip.
+                    const Glyph* glyph = font.glyphs->find(character);
+                    if (glyph == nullptr) continue;
+
+                    // Spaces separate words, but are kept as glyphs so they are drawn between words on the same line.
+                    if (character == ' ') endWord(false);
+
+                    xPos += getKerning(font, previousCharacter, character, scaling.x);
+                    previousCharacter = character;
+
+                    if (character != ' ' && !inWord) {
+                        words.emplace_back(Word{ glyphs.size(), glyphs.size(), paragraphs.back().wordCount == 0 ? 1u : 0u, 0, 0.0f });
+                        wordStart = xPos;
+                        inWord    = true;
+                    }
+
+                    glyphs.emplace_back(DrawableGlyph{ glyph, xPos, scaling, tint, font.texture });
+                    heights.push_back(height);
+
+                    xPos += glyph->advance * scaling.x;
+
+                    // A line may break after a hyphen.
+                    if (character == '-') endWord(true);
+                }
+            }
+            endWord(false);
+
+            // We will populate these data points for drawing later.
+            DrawableLines lines(arena);
+            f32 totalHeight = 0.0f;
+
+            ArenaVector<ui32> lineStarts(arena);
+
+            // Adds a line of glyphs [first, last), returning false if it would overflow the rectangle vertically.
+            auto addLine = [&](ui32 first, ui32 last, f32 length, f32 height) {
+                for (ui32 g = first; g < last; ++g) {
+                    height = std::max(height, heights[g]);
+                }
+
+                if (totalHeight + height > rect.w) return false;
+
+                lines.emplace_back(DrawableLine{ length, height, ArenaVector<DrawableGlyph>(arena) });
+                lines.back().drawables.reserve(last - first);
+
+                f32 lineStart = first < last ? glyphs[first].xPos : 0.0f;
+                for (ui32 g = first; g < last; ++g) {
+                    lines.back().drawables.emplace_back(glyphs[g]);
+                    lines.back().drawables.back().xPos -= lineStart;
+                }
+
+                totalHeight += height;
+                return true;
+            };
+
+            bool verticalOverflow = false;
+            for (auto& paragraph : paragraphs) {
+                // Empty paragraphs still take up a line.
+                if (paragraph.wordCount == 0) {
+                    verticalOverflow = !addLine(0, 0, 0.0f, paragraph.height);
+                    if (verticalOverflow) break;
+
+                    continue;
+                }
+
+                const Word* paragraphWords = &words[paragraph.firstWord];
+
+                findMinRagBreaks(arena, &starts[paragraph.firstWord], &ends[paragraph.firstWord], paragraph.wordCount, rect.z, lineStarts);
+
+                for (size_t l = 0; l < lineStarts.size(); ++l) {
+                    ui32 firstWord = lineStarts[l];
+                    ui32 lastWord  = l + 1 < lineStarts.size() ? lineStarts[l + 1] - 1 : paragraph.wordCount - 1;
+
+                    f32 length = ends[paragraph.firstWord + lastWord] - starts[paragraph.firstWord + firstWord];
+
+                    // Only the first line of a paragraph after a forced break takes the height of the break's font.
+                    f32 height = l == 0 ? paragraph.height : 0.0f;
+
+                    verticalOverflow = !addLine(static_cast<ui32>(paragraphWords[firstWord].start),
+                                                static_cast<ui32>(paragraphWords[lastWord].end), length, height);
+                    if (verticalOverflow) break;
+                }
+
+                if (verticalOverflow) break;
+            }
+
+            finaliseLayout(lines, totalHeight, rect, align, layout);
+        }
+
+
+
+        /******************************************************\
+         * Drawing                                            *
+        \******************************************************/
+
+        /**
+         * @brief Draws the glyphs of a laid out string.
+         *
+         * @tparam DrawTarget The type drawn to, either SpriteBatcher or SpriteBatcher::DrawContext.
+         *
+         * @param batcher The sprite batcher (or draw context) to draw the string to.
+         * @param layout The layout of the string.
+         * @param offset The offset to draw the string at from where it was laid out.
          * @param depth The depth at which to render the string.
          */
-        // inline void drawMinRagWrapString(SpriteBatcher* batcher, StringComponents components, f32v4 rect, TextAlign align, f32 depth) {
-        //     std::vector<std::vector<Word>> words;
-        //     words.resize(components.size());
-
-        //     // Split the string of each component into their costituent words in preparation for calculating the appropriate
-        //     // construction of lines to minimise the raggedness.
-        //     for (size_t i = 0; i < words.size(); ++i) {
-        //         auto& component = components[i];
-
-        //         // Simplify some component property names.
-        //         const char*  str    = component.first;
-        //         FontInstance font   = component.second.fontInstance;
-        //         StringSizing sizing = component.second.sizing;
-
-        //         char start = font.owner->getStart();
-        //         char end   = font.owner->getEnd();
-
-        //         // Process sizing into a simple scale factor.
-        //         f32v2 scaling;
-        //         f32   height;
-        //         if (sizing.kind == StringSizingKind::SCALED) {
-        //             scaling = sizing.scaling;
-        //             height  = static_cast<f32>(font.height) * scaling.y;
-        //         } else {
-        //             scaling.x = sizing.scaleX;
-        //             scaling.y = sizing.targetHeight / static_cast<f32>(font.height);
-        //             height    = sizing.targetHeight;
-        //         }
-
-        //         size_t beginIndex   = 0;
-        //         size_t currentIndex = 0;
-
-        //         // Estabilsh the Word object we will use to building each
-        //         // word in the component string.
-        //         Word latest = {
-        //             0,
-        //             0,
-        //             0,
-        //             0,
-        //             0.0f
-        //         };
-
-        //         // Simple function to reset the latest Word object.
-        //         auto resetLatest = [&]() {
-        //             latest = {
-        //                 currentIndex + 1,
-        //                 currentIndex + 1,
-        //                 0,
-        //                 0,
-        //                 0.0f
-        //             };
-        //         }
-
-        //         for (; str[currentIndex] != '\0'; ++currentIndex) {
-        //             // Determine character at current point in string.
-        //             char   character      = str[currentIndex];
-        //             size_t characterIndex = static_cast<size_t>(character) - static_cast<size_t>(start);
-
-        //             // If character is unsupported, skip.
-        //             if (character < start || character > end ||
-        //                     !font.glyphs[characterIndex].supported) continue;
-
-        //             //// For any of the breakable characters, add the current word to the list of words
-        //             //// and prepare to accept a get the next word.
-        //             // If we are going to a new line, mark the next word as such.
-        //             if (character == '\n') {
-        //                 words[i].push_back(latest);
-
-        //                 resetLatest();
-
-        //                 latest.newline = 1;
-
-        //                 continue;
-        //             // If we are dealing with a hyphen, mark the next word as being hyphenated.
-        //             } else if (character == '-') {
-        //                 words[i].push_back(latest);
-
-        //                 resetLatest();
-
-        //                 latest.hyphen = 1;
-
-        //                 size_t index   = static_cast<size_t>('-') - static_cast<size_t>(start);
-        //                 latest.length += font.glyphs[index].size.x * scaling.x;
-
-        //                 continue;
-        //             // If we are just dealing with a new word, don't do anything extra.
-        //             } else if (character == ' ') {
-        //                 words[i].push_back(latest);
-
-        //                 resetLatest();
-
-        //                 continue;
-        //             }
-
-        //             // Increment end index of word.
-        //             ++latest.end;
-        //             // Determine character width after scaling and increment word length by it.
-        //             latest.length += font.glyphs[characterIndex].size.x * scaling.x;
-        //         }
-
-        //         //
-        //     }
-
-        //     std::vector<std::vector<f32>> displacements;
-        //     // TODO(Matthew): Can we make guesses as to the amount of drawables to reserve for a line? For amount of lines?
-
-
-        // }
-
-
-
-        //     // We will populate these data points for drawing later.
-        //     DrawableLines lines;
-        //     f32 totalHeight = 0.0f;
-
-        //     // Place the first line.
-        //     lines.emplace_back(DrawableLine{0.0f, 0.0f, std::vector<DrawableGlyph>()});
-
-        //     for (auto& component : components) {
-        //         // Simplify property names.
-        //         const char*  str    = component.first;
-        //         FontInstance font   = component.second.fontInstance;
-        //         StringSizing sizing = component.second.sizing;
-        //         colour4      tint   = component.second.tint;
-
-        //         char start = font.owner->getStart();
-        //         char end   = font.owner->getEnd();
-
-        //         // Process sizing into a simple scale factor.
-        //         f32v2 scaling;
-        //         f32   height;
-        //         if (sizing.kind == StringSizingKind::SCALED) {
-        //             scaling    = sizing.scaling;
-        //             height = static_cast<f32>(font.height) * scaling.y;
-        //         } else {
-        //             scaling.x  = sizing.scaleX;
-        //             scaling.y  = sizing.targetHeight / static_cast<f32>(font.height);
-        //             height = sizing.targetHeight;
-        //         }
-
-        //         // We have to do per-word lookahead before adding any characters to the lines, these data points
-        //         // enable us to do this.
-        //         ui32 beginIndex   = 0;
-        //         ui32 currentIndex = 0;
-        //         f32  wordLength   = 0.0f;
-
-        //         // Useful functor to flush current word to line.
-        //         auto flushWordToLine = [&]() {
-        //             while (beginIndex != currentIndex) {
-        //                 // Get glyph index of character at string index.
-        //                 char   character      = str[beginIndex];
-        //                 size_t characterIndex = static_cast<size_t>(character) - static_cast<size_t>(start);
-
-        //                 // Add character to line for drawing.
-        //                 lines.back().drawables.emplace_back(DrawableGlyph{ &font.glyphs[characterIndex], lines.back().length, scaling, tint, font.texture });
-
-        //                 // Determine character width after scaling & add to line length.
-        //                 f32 characterWidth = font.glyphs[characterIndex].size.x * scaling.x;
-        //                 lines.back().length += characterWidth;
-
-        //                 ++beginIndex;
-        //             }
-
-        //             // Reset word length.
-        //             wordLength = 0.0f;
-        //         };
-
-        //         // Gets set to true if we go out of the height of the rect.
-        //         bool verticalOverflow = false;
-        //         // Iterate over this component's string.
-        //         for (; str[currentIndex] != '\0'; ++currentIndex) {
-        //             char   character      = str[currentIndex];
-        //             size_t characterIndex = static_cast<size_t>(character) - static_cast<size_t>(start);
-
-        //             // If character is a new line character, add a new line and go to next character.
-        //             if (character == '\n') {
-        //                 // But first, we need to flush the most recent word if it exists.
-        //                 flushWordToLine();
-
-        //                 totalHeight += lines.back().height;
-        //                 lines.emplace_back(DrawableLine{ 0.0f, height, std::vector<DrawableGlyph>() });
-
-        //                 continue;
-        //             }
-
-        //             // If character is unsupported, skip.
-        //             if (character < start || character > end ||
-        //                     !font.glyphs[characterIndex].supported) continue;
-
-        //             // Determine character width after scaling.
-        //             f32 characterWidth = font.glyphs[characterIndex].size.x * scaling.x;
-
-        //             // For characters on which we may break a line, flush the word so far
-        //             // prematurely so that the breakable character can be handled correctly.
-        //             if (character == ' ' || character == '-') {
-        //                 flushWordToLine();
-        //             }
-
-        //             // Given we are about to add a character, make sure it fits on the line, if not, make
-        //             // a new line and if the about-to-be-added character isn't a whitespace revisit it.
-        //             if (lines.back().length + wordLength + characterWidth > rect.z) {
-        //                 totalHeight += lines.back().height;
-        //                 lines.emplace_back(DrawableLine{ 0.0f, height, std::vector<DrawableGlyph>() });
-
-        //                 // Skip whitespace at start of new line.
-        //                 if (str[beginIndex] == ' ') {
-        //                     ++beginIndex;
-        //                 }
-        //                 continue;
-        //             }
-
-        //             // If the line's height is less than the height of this font instance, and we're about to add a
-        //             // glyph from this font instance, then the line's height needs setting to the font instances's.
-        //             if (lines.back().height < height) {
-        //                 // If we have overflowed the rectangle with the new line height, break out instead.
-        //                 if (totalHeight + height > rect.w) {
-        //                     verticalOverflow = true;
-        //                     break;
-        //                 }
-        //                 lines.back().height = height;
-        //             }
-
-        //             wordLength += characterWidth;
-        //         }
-
-        //         // If we have overflown vertically, break out of outer loop.
-        //         if (verticalOverflow) break;
-
-        //         // Flush any remaining word to line.
-        //         flushWordToLine();
-        //     }
-        //     // Update the total height for last line.
-        //     totalHeight += lines.back().height;
-
-        //     f32 currentY = 0.0f;
-        //     for (auto& line : lines) {
-        //         f32v2 offsets = calculateOffset(align, rect, totalHeight, line.length);
-
-        //         for (auto& drawable : line.drawables) {
-        //             f32v2 size         = drawable.glyph->size * drawable.scaling;
-        //             f32v2 position     = f32v2(drawable.xPos, currentY) + offsets + f32v2(rect.x, rect.y) + f32v2(0.0f, line.height - size.y);
-        //             f32v4 uvDimensions = drawable.glyph->uvDimensions;
-
-        //             f32v2 oldSize = size;
-
-        //             clip(rect, position, size, uvDimensions);
-
-        //             // Reject any character that even slightly clips with the bounding rectangle.
-        //             if (oldSize == size) {
-        //                 batcher->draw(drawable.texture, position, size, drawable.tint,
-        //                                 { 255, 255, 255, 255 }, Gradient::NONE, depth, uvDimensions);
-        //             } else {
-        //                 continue;
-        //             }
-        //         }
-
-        //         currentY += line.height;
-        //     }
-        // }
+        template <typename DrawTarget>
+        inline void drawTextLayout(DrawTarget* batcher, const TextLayout& layout, const f32v2& offset, f32 depth) {
+            const ui32 glyphCount = static_cast<ui32>(layout.glyphs.size());
+
+            for (ui32 i = 0; i < glyphCount; ++i) {
+                if (i == layout.firstClippedGlyph) batcher->pushClipRect(layout.rect + f32v4(offset.x, offset.y, 0.0f, 0.0f));
+
+                const LayoutGlyph& glyph = layout.glyphs[i];
+
+                batcher->draw(glyph.texture, glyph.position + offset, glyph.size, glyph.tint,
+                                { 255, 255, 255, 255 }, Gradient::NONE, depth, glyph.uvDimensions);
+            }
+
+            if (layout.firstClippedGlyph < glyphCount) batcher->popClipRect();
+        }
     }
 }
 
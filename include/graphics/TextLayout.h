@@ -0,0 +1,174 @@
+/**
+ * @file TextLayout.h
+ * @brief Provides the laid out glyphs of a string, and a cache of layouts so that unchanged strings need not be laid out again.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_TextLayout_h__)
+#define SP_Graphics_TextLayout_h__
+
+#include <vector>
+
+#include "types.h"
+#include "graphics/Font.h"
+#include "graphics/FrameArena.h"
+#include "graphics/TextAlign.h"
+#include "graphics/WordWrap.hpp"
+
+namespace SecretProject {
+    namespace graphics {
+        // The number of layouts a layout cache keeps by default, before evicting the least recently used.
+        const ui32 DEFAULT_TEXT_LAYOUT_CACHE_CAPACITY = 512;
+
+        /**
+         * @brief A glyph placed by layout, ready to be drawn as a sprite.
+         */
+        struct LayoutGlyph {
+            f32v2   position;
+            f32v2   size;
+            f32v4   uvDimensions;
+            colour4 tint;
+            GLuint  texture;
+        };
+
+        /**
+         * @brief A line of laid out glyphs.
+         */
+        struct LayoutLine {
+            ui32 firstGlyph;
+            ui32 glyphCount;
+            f32  length;
+            f32  height;
+        };
+
+        /**
+         * @brief The result of laying out a string within a rectangle - where each of its
+         * glyphs is drawn and how it was broken into lines.
+         *
+         * Glyphs are positioned in the same coordinates as the rectangle, with alignment
+         * already applied. Glyphs from firstClippedGlyph on are drawn clipped to the
+         * rectangle, as the first of them crosses its edge.
+         */
+        struct TextLayout {
+            std::vector<LayoutGlyph> glyphs;
+            std::vector<LayoutLine>  lines;
+            f32v4                    rect;
+            f32v2                    size;
+            ui32                     firstClippedGlyph;
+
+            /**
+             * @brief Empties the layout, keeping its memory to lay out into again.
+             */
+            void clear();
+        };
+
+        /**
+         * @brief Provides a least-recently-used cache of text layouts, keyed by
+         * everything that determines a layout: the bytes of each string component and
+         * its font instance, sizing and tint, along with the rectangle, alignment and
+         * wrapping laid out with.
+         *
+         * Keys are hashed to find entries, and compared in full to confirm a match. The
+         * memory of evicted entries is reused by those that replace them, so once the
+         * cache is full, looking up a layout allocates nothing new unless it is larger
+         * than any seen before.
+         *
+         * Fonts are identified by their texture and glyphs, so if a font instance is
+         * disposed of, the cache must be cleared before another could be generated in
+         * its place.
+         */
+        class TextLayoutCache {
+        public:
+            TextLayoutCache();
+
+            /**
+             * @brief Initialises the cache.
+             *
+             * @param capacity The most layouts to keep.
+             */
+            void init(ui32 capacity = DEFAULT_TEXT_LAYOUT_CACHE_CAPACITY);
+            /**
+             * @brief Disposes of the cache and all layouts it holds.
+             */
+            void dispose();
+
+            /**
+             * @brief Forgets every layout, keeping the memory of each for reuse.
+             */
+            void clear();
+
+            /**
+             * @brief Gets the layout of the given string components, laying them out in
+             * place of the least recently used layout if not already cached.
+             *
+             * @param arena The arena to make any transient allocations from.
+             * @param components The string components to lay out.
+             * @param componentCount The number of string components.
+             * @param rect The bounding rectangle the string must be kept within.
+             * @param align The alignment for the text.
+             * @param wrap The wrapping mode to use for the string.
+             *
+             * @return The layout, valid until the next call to fetch.
+             */
+            const TextLayout& fetch(        FrameArena* arena,
+                                    const StringComponent* components,
+                                                  size_t componentCount,
+                                                   f32v4 rect,
+                                               TextAlign align,
+                                                WordWrap wrap);
+        protected:
+            /**
+             * @brief A cached layout, linked into the list of entries from most to least
+             * recently used.
+             */
+            struct Entry {
+                ui64             hash;
+                std::vector<ui8> key;
+                TextLayout       layout;
+                ui32             previous, next;
+            };
+
+            /**
+             * @brief Finds the slot of the table that holds, or would hold, the entry
+             * of the given key.
+             */
+            ui32 findSlot(ui64 hash, const ui8* key, size_t keySize) const;
+            /**
+             * @brief Removes the entry held in the given slot from the table, shifting
+             * back any entries that collided past it.
+             */
+            void eraseSlot(ui32 slot);
+
+            void unlink(ui32 entry);
+            void linkFront(ui32 entry);
+
+            std::vector<Entry> m_entries;
+            std::vector<ui32>  m_slots; // Open-addressed table of entry indices, sized a power of two.
+            ui32               m_capacity;
+            ui32               m_head, m_tail;
+        };
+
+        /**
+         * @brief Lays out the given string components within the given rectangle.
+         *
+         * @param arena The arena to make any transient allocations from.
+         * @param components The string components to lay out.
+         * @param componentCount The number of string components.
+         * @param rect The bounding rectangle the string must be kept within.
+         * @param align The alignment for the text.
+         * @param wrap The wrapping mode to use for the string.
+         * @param layout The layout to populate, any existing contents are cleared.
+         */
+        void layoutStringComponents(        FrameArena* arena,
+                                    const StringComponent* components,
+                                                  size_t componentCount,
+                                                   f32v4 rect,
+                                               TextAlign align,
+                                                WordWrap wrap,
+                                              TextLayout& layout);
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_TextLayout_h__)
@@ -0,0 +1,123 @@
+/**
+ * @file TextureArraySet.h
+ * @brief Provides a set of texture arrays into which same-sized textures are gathered.
+ */
+
+#pragma once
+
+#if !defined(SP_Graphics_TextureArraySet_h__)
+#define SP_Graphics_TextureArraySet_h__
+
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace graphics {
+        // The number of layers a texture array is first created with.
+        const ui32 INITIAL_TEXTURE_ARRAY_LAYERS = 16;
+
+        /**
+         * @brief Provides a set of GL_TEXTURE_2D_ARRAY textures, one per texture size,
+         * into which 2D textures are copied as layers. Sprites using any texture in the
+         * same array can then be drawn with a single draw call, picking their layer in
+         * the shader.
+         *
+         * The 2D textures are still used to refer to the textures, the set maps them to
+         * the array and layer they have been copied into. Note that the copy is made at
+         * the time the texture is added - later changes to the 2D texture are not seen.
+         */
+        class TextureArraySet {
+        public:
+            TextureArraySet();
+            ~TextureArraySet() { /* Empty */ }
+
+            /**
+             * @brief Disposes of the set, deleting all of its texture arrays. The 2D
+             * textures added are left alone.
+             */
+            void dispose();
+
+            /**
+             * @brief Adds the given 2D texture to the array of textures of its size,
+             * creating or growing that array as needed. The texture is read back and
+             * copied, so this is not cheap - add textures once, up front.
+             *
+             * @param texture The 2D texture to add.
+             *
+             * @return True if the texture was added (or already had been), false
+             * otherwise.
+             */
+            bool add(GLuint texture);
+
+            /**
+             * @brief Resolves the given 2D texture to the texture array it was added to,
+             * and its layer within that array.
+             *
+             * @param texture The 2D texture to resolve.
+             * @param layer Set to the layer of the texture within the array, or -1 if
+             * the texture has not been added to the set.
+             *
+             * @return The texture array holding the texture, or the texture itself if
+             * it has not been added to the set.
+             */
+            GLuint resolve(GLuint texture, i32& layer) const {
+                auto it = m_slots.find(texture);
+                if (it == m_slots.end()) {
+                    layer = -1;
+                    return texture;
+                }
+
+                layer = it->second.layer;
+                return m_arrays[it->second.array].id;
+            }
+        protected:
+            /**
+             * @brief The properties of a texture array in the set.
+             */
+            struct TextureArray {
+                GLuint              id;
+                GLsizei             width, height;
+                ui32                capacity;
+                std::vector<GLuint> layers; // The 2D textures copied into each layer.
+            };
+
+            /**
+             * @brief The location of a texture within the set.
+             */
+            struct TextureSlot {
+                ui32 array;
+                i32  layer;
+            };
+
+            /**
+             * @brief Creates the given texture array with the given capacity, or grows
+             * it to that capacity, copying in any layers it already holds. A grown array
+             * keeps its ID, so sprites already batched against it stay valid.
+             *
+             * @param textureArray The texture array to create.
+             * @param capacity The number of layers to create the array with.
+             */
+            void create(TextureArray& textureArray, ui32 capacity);
+            /**
+             * @brief Copies the given 2D texture into the given layer of the texture
+             * array. The texture array must be bound.
+             *
+             * @param textureArray The texture array to copy into.
+             * @param texture The 2D texture to copy.
+             * @param layer The layer to copy the texture into.
+             */
+            void copy(const TextureArray& textureArray, GLuint texture, ui32 layer);
+
+            std::vector<TextureArray>               m_arrays;
+            std::unordered_map<GLuint, TextureSlot> m_slots;
+            std::vector<ui8>                        m_pixels;
+
+            GLint m_maxLayers;
+        };
+    }
+}
+namespace spg = SecretProject::graphics;
+
+#endif // !defined(SP_Graphics_TextureArraySet_h__)
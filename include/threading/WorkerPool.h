@@ -0,0 +1,91 @@
+/**
+ * @file WorkerPool.h
+ * @brief Provides a pool of worker threads for splitting work across cores.
+ */
+
+#pragma once
+
+#if !defined(SP_Threading_WorkerPool_h__)
+#define SP_Threading_WorkerPool_h__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+namespace SecretProject {
+    namespace threading {
+        // The signature of a task run over the range [begin, end) of some work.
+        using RangeTask = std::function<void(size_t begin, size_t end)>;
+
+        /**
+         * @brief Provides a pool of worker threads that split ranges of work between
+         * themselves (and the calling thread) in chunks.
+         *
+         * Workers sleep between jobs, and take chunks of a job from a shared counter
+         * as they finish their previous chunk - so uneven chunks balance themselves
+         * across the workers.
+         *
+         * Note that only one thread may submit work to a pool at any one time.
+         */
+        class WorkerPool {
+        public:
+            WorkerPool();
+            ~WorkerPool() { dispose(); }
+
+            /**
+             * @brief Initialises the worker pool, starting its worker threads.
+             *
+             * @param workerCount The number of worker threads to start. If zero, one
+             * fewer than the number of hardware threads is used (as the calling thread
+             * also takes part in each job).
+             */
+            void init(ui32 workerCount = 0);
+            /**
+             * @brief Disposes of the worker pool, waking and joining all workers.
+             */
+            void dispose();
+
+            ui32 getWorkerCount() const { return static_cast<ui32>(m_workers.size()); }
+
+            /**
+             * @brief Runs the given task over the range [0, count), split into chunks
+             * of at most chunkSize, on the workers and the calling thread. Returns once
+             * every chunk has been completed.
+             *
+             * @param count The size of the range to run the task over.
+             * @param chunkSize The maximum size of each chunk handed to the task.
+             * @param task The task to run on each chunk.
+             */
+            void parallelFor(size_t count, size_t chunkSize, const RangeTask& task);
+        protected:
+            /**
+             * @brief The loop run by each worker thread.
+             */
+            void workerLoop();
+            /**
+             * @brief Runs chunks of the current job until none remain.
+             */
+            void runChunks();
+
+            std::vector<std::thread> m_workers;
+
+            std::mutex              m_mutex;
+            std::condition_variable m_wake, m_done;
+            bool                    m_quit;
+            ui64                    m_generation;
+            ui32                    m_activeWorkers;
+
+            const RangeTask*    m_task;
+            size_t              m_count, m_chunkSize, m_chunkCount;
+            std::atomic<size_t> m_nextChunk;
+        };
+    }
+}
+namespace spthread = SecretProject::threading;
+
+#endif // !defined(SP_Threading_WorkerPool_h__)
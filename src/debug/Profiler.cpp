@@ -0,0 +1,187 @@
+#include "stdafx.h"
+#include "debug/Profiler.h"
+
+#include <chrono>
+
+std::vector<spdebug::ProfileEvent> spdebug::Profiler::s_events;
+std::atomic<size_t>                spdebug::Profiler::s_next(0);
+ui64                               spdebug::Profiler::s_epoch = 0;
+
+/**
+ * @brief Reads the steady clock in nanoseconds.
+ */
+static ui64 clockNanoseconds() {
+    return static_cast<ui64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+/**
+ * @brief Writes the given string to the given file as a JSON string, escaping as needed.
+ */
+static void writeJsonString(FILE* file, const char* str) {
+    fputc('"', file);
+    for (; *str != '\0'; ++str) {
+        char c = *str;
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if (static_cast<ui8>(c) < 0x20) {
+            fprintf(file, "\\u%04x", static_cast<ui32>(c));
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+void spdebug::Profiler::init(size_t capacity /*= DEFAULT_PROFILER_CAPACITY*/) {
+    s_events.resize(capacity);
+    s_next.store(0);
+    s_epoch = clockNanoseconds();
+}
+
+void spdebug::Profiler::dispose() {
+    std::vector<ProfileEvent>().swap(s_events);
+    s_next.store(0);
+    s_epoch = 0;
+}
+
+ui64 spdebug::Profiler::now() {
+    return clockNanoseconds() - s_epoch;
+}
+
+ui32 spdebug::Profiler::getThreadID() {
+    static std::atomic<ui32> nextID(0);
+    thread_local ui32 id = nextID.fetch_add(1);
+
+    return id;
+}
+
+void spdebug::Profiler::record(const ProfileEvent& event) {
+    if (s_events.empty()) return;
+
+    size_t slot = s_next.fetch_add(1, std::memory_order_relaxed);
+    s_events[slot % s_events.size()] = event;
+}
+
+void spdebug::Profiler::getEvents(std::vector<ProfileEvent>& events) {
+    events.clear();
+    if (s_events.empty()) return;
+
+    // Once the ring has wrapped, the oldest event is the one the next would overwrite.
+    size_t next     = s_next.load();
+    size_t capacity = s_events.size();
+    size_t count    = std::min(next, capacity);
+
+    events.reserve(count);
+    for (size_t i = next - count; i < next; ++i) {
+        events.push_back(s_events[i % capacity]);
+    }
+}
+
+bool spdebug::Profiler::dumpChromeTrace(const char* filepath) {
+    FILE* file = fopen(filepath, "w");
+    if (file == nullptr) return false;
+
+    std::vector<ProfileEvent> events;
+    getEvents(events);
+
+    // Each event is a complete ("X") event, with times in microseconds. The GPU gets a track of its own, named
+    // with a metadata ("M") event.
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", GPU_THREAD_ID);
+    for (auto& event : events) {
+        fprintf(file, ",\n{\"name\":");
+        writeJsonString(file, event.name);
+        fprintf(file, ",\"cat\":");
+        writeJsonString(file, event.category);
+        fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+                    static_cast<f64>(event.start) / 1000.0, static_cast<f64>(event.duration) / 1000.0, event.thread);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool success = ferror(file) == 0;
+    fclose(file);
+
+    return success;
+}
+
+spdebug::ScopedTimer::~ScopedTimer() {
+    if (!Profiler::isInitialised()) return;
+
+    ui64 end = Profiler::now();
+    Profiler::record({ m_name, m_category, m_start, end - m_start, Profiler::getThreadID() });
+}
+
+spdebug::GPUTimer::GPUTimer() :
+    m_current(0),
+    m_timing(false)
+{
+    /* Empty */
+}
+
+void spdebug::GPUTimer::init(ui32 queryCount /*= DEFAULT_GPU_TIMER_QUERIES*/) {
+    m_queries.resize(queryCount, Query{ 0, nullptr, 0, false });
+    for (auto& query : m_queries) {
+        glGenQueries(1, &query.id);
+    }
+
+    m_current = 0;
+    m_timing  = false;
+}
+
+void spdebug::GPUTimer::dispose() {
+    // A query can't be deleted while active.
+    if (m_timing) end();
+
+    for (auto& query : m_queries) {
+        glDeleteQueries(1, &query.id);
+    }
+    std::vector<Query>().swap(m_queries);
+
+    m_current = 0;
+}
+
+void spdebug::GPUTimer::begin(const char* name) {
+    if (m_queries.empty() || m_timing) return;
+
+    // If the GPU hasn't yet got to the oldest query, we skip this timing rather than wait for it.
+    Query& query = m_queries[m_current];
+    if (query.pending) return;
+
+    query.name    = name;
+    query.start   = Profiler::now();
+    query.pending = true;
+
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+    m_timing = true;
+}
+
+void spdebug::GPUTimer::end() {
+    if (!m_timing) return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    m_timing = false;
+
+    m_current = (m_current + 1) % static_cast<ui32>(m_queries.size());
+}
+
+void spdebug::GPUTimer::collect() {
+    // Results become available in the order queries were issued, so we read from the oldest until we find one
+    // that isn't ready.
+    for (size_t i = 0; i < m_queries.size(); ++i) {
+        Query& query = m_queries[(m_current + i) % m_queries.size()];
+        if (!query.pending || (m_timing && &query == &m_queries[m_current])) continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE) break;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsed);
+        query.pending = false;
+
+        Profiler::record({ query.name, "gpu", query.start, elapsed, GPU_THREAD_ID });
+    }
+}
@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "graphics/ClipStack.h"
+
+ui32 spg::ClipStack::push(const f32v4& rect) {
+    f32v4 clipped = rect;
+
+    // Keep within the current clip rectangle, if any. Rectangles that don't overlap at all
+    // are left with zero size rather than negative.
+    ui32 current = getCurrent();
+    if (current != NO_CLIP) {
+        const f32v4& parent = getRect(current);
+
+        f32 left   = std::max(rect.x, parent.x);
+        f32 top    = std::max(rect.y, parent.y);
+        f32 right  = std::min(rect.x + rect.z, parent.x + parent.z);
+        f32 bottom = std::min(rect.y + rect.w, parent.y + parent.w);
+
+        clipped = f32v4(left, top, std::max(right - left, 0.0f), std::max(bottom - top, 0.0f));
+    }
+
+    // The same rectangle is often pushed many times over (e.g. for each string drawn in
+    // a panel), and reusing the last one keeps those sprites in the same batches.
+    if (m_rects.empty() || m_rects.back() != clipped) m_rects.emplace_back(clipped);
+
+    m_stack.emplace_back(static_cast<ui32>(m_rects.size()));
+
+    return m_stack.back();
+}
+
+void spg::ClipStack::pop() {
+    if (!m_stack.empty()) m_stack.pop_back();
+}
+
+void spg::ClipStack::clear() {
+    m_rects.clear();
+    m_stack.clear();
+}
+
+void spg::ClipStack::dispose() {
+    std::vector<f32v4>().swap(m_rects);
+    std::vector<ui32>().swap(m_stack);
+}
+
+ui32 spg::ClipStack::append(const ClipStack& other) {
+    ui32 offset = static_cast<ui32>(m_rects.size());
+
+    m_rects.insert(m_rects.end(), other.m_rects.begin(), other.m_rects.end());
+
+    return offset;
+}
+
+i32v4 spg::projectClipRect(const f32v4& rect, const f32m4& transform, const i32v4& viewport) {
+    f32v2 corners[4] = {
+        f32v2(rect.x,          rect.y),
+        f32v2(rect.x + rect.z, rect.y),
+        f32v2(rect.x,          rect.y + rect.w),
+        f32v2(rect.x + rect.z, rect.y + rect.w)
+    };
+
+    // Take each corner of the clip rectangle through to normalised device coordinates, and
+    // from there to window coordinates. The scissor rectangle is then the bounds of those.
+    //     Window coordinates have their origin at the bottom left, as do NDCs, so the flip
+    //     in y of our projections is already accounted for.
+    f32v2 minimum(std::numeric_limits<f32>::max());
+    f32v2 maximum(std::numeric_limits<f32>::lowest());
+    for (auto& corner : corners) {
+        f32v4 clip = transform * f32v4(corner.x, corner.y, 0.0f, 1.0f);
+
+        f32 x = static_cast<f32>(viewport.x) + (clip.x / clip.w * 0.5f + 0.5f) * static_cast<f32>(viewport.z);
+        f32 y = static_cast<f32>(viewport.y) + (clip.y / clip.w * 0.5f + 0.5f) * static_cast<f32>(viewport.w);
+
+        minimum.x = std::min(minimum.x, x);
+        minimum.y = std::min(minimum.y, y);
+        maximum.x = std::max(maximum.x, x);
+        maximum.y = std::max(maximum.y, y);
+    }
+
+    // Round outwards, so that pixels only partly covered by the clip rectangle are still drawn.
+    i32 left   = static_cast<i32>(std::floor(minimum.x));
+    i32 bottom = static_cast<i32>(std::floor(minimum.y));
+    i32 right  = static_cast<i32>(std::ceil(maximum.x));
+    i32 top    = static_cast<i32>(std::ceil(maximum.y));
+
+    return i32v4(left, bottom, std::max(right - left, 0), std::max(top - bottom, 0));
+}
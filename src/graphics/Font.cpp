@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "graphics/Font.h"
 
+#include "debug/Profiler.h"
 #include "io/ImageIO.h"
 
 /**
@@ -69,16 +70,45 @@ bool spg::FontInstance::saveAsPng(const char* filepath) {
     return spio::Image::PNG::save(filepath, static_cast<void*>(pixels), textureSize, spio::Image::PixelFormat::RGBA_UI8);
 }
 
+spg::GlyphTable::GlyphTable() {
+    std::fill(std::begin(m_directory), std::end(m_directory), NO_GLYPH_PAGE);
+}
+
+spg::Glyph& spg::GlyphTable::insert(char32_t codepoint) {
+    ui16& page = m_directory[codepoint / GLYPH_PAGE_SIZE];
+
+    // Store the page the first time a glyph in it is inserted, with every glyph unsupported.
+    if (page == NO_GLYPH_PAGE) {
+        page = static_cast<ui16>(m_glyphs.size() / GLYPH_PAGE_SIZE);
+
+        m_glyphs.resize(m_glyphs.size() + GLYPH_PAGE_SIZE, Glyph{});
+
+        char32_t first = codepoint - codepoint % GLYPH_PAGE_SIZE;
+        for (char32_t i = 0; i < GLYPH_PAGE_SIZE; ++i) {
+            m_glyphs[page * GLYPH_PAGE_SIZE + i].character = first + i;
+        }
+    }
+
+    return m_glyphs[page * GLYPH_PAGE_SIZE + codepoint % GLYPH_PAGE_SIZE];
+}
+
 spg::Font::Font() :
     m_filepath(nullptr),
-    m_start(0), m_end(0),
     m_defaultSize(0)
 { /* Empty. */ }
 
-void spg::Font::init(const char* filepath, char start, char end) {
+void spg::Font::init(const char* filepath, char32_t start, char32_t end) {
     m_filepath = filepath;
-    m_start    = start;
-    m_end      = end;
+
+    m_codepoints.clear();
+    addCodepoints(start, end);
+}
+
+void spg::Font::addCodepoints(char32_t start, char32_t end) {
+    end = std::min(end, LAST_GLYPH_CODEPOINT);
+    if (start > end) return;
+
+    m_codepoints.emplace_back(CodepointRange{ start, end });
 }
 
 void spg::Font::dispose() {
@@ -87,7 +117,10 @@ void spg::Font::dispose() {
             glDeleteTextures(1, &fontInstance.second.texture);
         }
         if (fontInstance.second.glyphs != nullptr) {
-            delete[] fontInstance.second.glyphs;
+            delete fontInstance.second.glyphs;
+        }
+        if (fontInstance.second.kerning != nullptr) {
+            delete[] fontInstance.second.kerning;
         }
     }
 
@@ -98,13 +131,15 @@ bool spg::Font::generate(       FontSize size,
                                 FontSize padding,
                                FontStyle style       /*= FontStyle::NORMAL*/,
                          FontRenderStyle renderStyle /*= FontRenderStyle::BLENDED*/) {
+    SP_PROFILE_ZONE("Font::generate");
+
     // Make sure this is a new instance we are generating.
     if (getFontInstance(size, style, renderStyle) != NIL_FONT_INSTANCE) return false;
 
     // This is the font instance we will build up as we generate the texture atlas.
     FontInstance fontInstance{};
-    // Create the glyphs array for this font instance.
-    fontInstance.glyphs = new Glyph[m_end - m_start + 1];
+    // Create the glyph table for this font instance.
+    fontInstance.glyphs = new GlyphTable();
     // Set this as the font instance's owner.
     fontInstance.owner = this;
 
@@ -118,40 +153,80 @@ bool spg::Font::generate(       FontSize size,
     // Store the height of the tallest glyph for the given font size.
     fontInstance.height = TTF_FontHeight(font);
 
+    // Insert every glyph into the table before taking any pointers into it, as inserting may move them.
+    for (auto& range : m_codepoints) {
+        for (char32_t c = range.first; c <= range.last; ++c) {
+            fontInstance.glyphs->insert(c);
+        }
+    }
+
     // For each character, we are going to get the glyph metrics - that is the set of
     // properties that constitute begin and end positions of the glyph - and calculate
-    // each glyph's size.
-    {
-        size_t i = 0;
-        for (char c = m_start; c <= m_end; ++c) {
-            fontInstance.glyphs[i].character = c;
+    // each glyph's size. Those glyphs the font provides are gathered to be packed into
+    // the texture atlas.
+    std::vector<Glyph*> glyphs;
+    for (auto& range : m_codepoints) {
+        for (char32_t c = range.first; c <= range.last; ++c) {
+            Glyph& glyph = fontInstance.glyphs->insert(c);
+
+            // Ranges may overlap, skip any glyph we have already seen to.
+            if (glyph.supported) continue;
 
             // Check that the glyph we are currently seeking actually gets provided
             // by the font in question.
-            if (TTF_GlyphIsProvided(font, c) == 0) {
-                fontInstance.glyphs[i].supported = false;
-
-                ++i;
-                continue;
-            }
+            if (TTF_GlyphIsProvided(font, static_cast<ui16>(c)) == 0) continue;
 
             // We will fill this with the glyph metrics, namely min & max values of
             // the X & Y coords of the font.
             //     metrics.x & metrics.y correspond to min & max X respectively.
             //     metrics.z & metrics.w correspond to min & max Y respectively.
             i32v4 metrics;
+            i32   advance;
 
-            TTF_GlyphMetrics(font, c, &metrics.x, &metrics.y,
-                                    &metrics.z, &metrics.w, nullptr);
+            TTF_GlyphMetrics(font, static_cast<ui16>(c), &metrics.x, &metrics.y,
+                                                         &metrics.z, &metrics.w, &advance);
 
             // Calculate the glyph's sizes from the metric.
-            fontInstance.glyphs[i].size.x = metrics.y - metrics.x;
-            fontInstance.glyphs[i].size.y = metrics.w - metrics.z;
+            glyph.size.x = metrics.y - metrics.x;
+            glyph.size.y = metrics.w - metrics.z;
+
+            // Glyphs are rendered from the pen position, or from as far left of it as they reach.
+            glyph.advance = static_cast<f32>(advance);
+            glyph.bearing = static_cast<f32>(std::min(metrics.x, 0));
 
             // Given we got here, the glyph is supported.
-            fontInstance.glyphs[i].supported = true;
+            glyph.supported = true;
+
+            glyphs.push_back(&glyph);
+        }
+    }
+
+    // Look up the kerning of each pair of supported printable ASCII glyphs now, so that laying out strings
+    // is just a lookup into a table. We only keep the table if the font kerns some pair.
+    {
+        fontInstance.kerning = new i16[KERNING_TABLE_WIDTH * KERNING_TABLE_WIDTH]();
+
+        bool kerns = false;
+        for (char32_t first = 0; first < KERNING_TABLE_WIDTH; ++first) {
+            char32_t firstCodepoint = FIRST_PRINTABLE_CHAR + first;
+            if (fontInstance.glyphs->find(firstCodepoint) == nullptr) continue;
+
+            for (char32_t second = 0; second < KERNING_TABLE_WIDTH; ++second) {
+                char32_t secondCodepoint = FIRST_PRINTABLE_CHAR + second;
+                if (fontInstance.glyphs->find(secondCodepoint) == nullptr) continue;
+
+                int kerning = TTF_GetFontKerningSizeGlyphs(font, static_cast<ui16>(firstCodepoint),
+                                                                 static_cast<ui16>(secondCodepoint));
+                if (kerning != 0) {
+                    fontInstance.kerning[first * KERNING_TABLE_WIDTH + second] = static_cast<i16>(kerning);
+                    kerns = true;
+                }
+            }
+        }
 
-            ++i;
+        if (!kerns) {
+            delete[] fontInstance.kerning;
+            fontInstance.kerning = nullptr;
         }
     }
 
@@ -165,14 +240,15 @@ bool spg::Font::generate(       FontSize size,
     ui32 bestArea     = std::numeric_limits<ui32>::max();
     ui32 bestRowCount = 0;
     Row* bestRows = nullptr;
-    while (rowCount <= static_cast<ui32>(m_end - m_start)) {
+    ui32 glyphCount   = static_cast<ui32>(glyphs.size());
+    while (rowCount <= glyphCount) {
         // WARNING: We may be packing too tightly here. The reported height of glyphs from TTF_GlyphMetrics
         //          is not always accurate to the rendered dimensions.
 
         // Generate rows for the current row count, getting the width and height of the rectangle
         // they form.
         ui32 currentWidth, currentHeight;
-        Row* currentRows = generateRows(fontInstance.glyphs, rowCount, padding, currentWidth, currentHeight);
+        Row* currentRows = generateRows(glyphs.data(), glyphCount, rowCount, padding, currentWidth, currentHeight);
 
         // There are benefits of making the texture larger to match power of 2 boundaries on
         // width and height.
@@ -236,19 +312,19 @@ bool spg::Font::generate(       FontSize size,
         // This represents the current U-coordinate we are into the texture.
         ui32 currentU = padding;
         for (size_t glyphIndex = 0; glyphIndex < bestRows[rowIndex].second.size(); ++glyphIndex) {
-            ui32 charIndex = bestRows[rowIndex].second[glyphIndex];
+            Glyph& glyph = *glyphs[bestRows[rowIndex].second[glyphIndex]];
 
             // If the glyph is unsupported, skip it!
-            if (!fontInstance.glyphs[charIndex].supported) continue;
+            if (!glyph.supported) continue;
 
             // Determine which render style we are to use and draw the glyph.
             SDL_Surface* glyphSurface = nullptr;
             switch(renderStyle) {
                 case FontRenderStyle::SOLID:
-                    glyphSurface = TTF_RenderGlyph_Solid(font, static_cast<ui16>(m_start + charIndex), { 255, 255, 255, 255 });
+                    glyphSurface = TTF_RenderGlyph_Solid(font, static_cast<ui16>(glyph.character), { 255, 255, 255, 255 });
                     break;
                 case FontRenderStyle::BLENDED:
-                    glyphSurface = TTF_RenderGlyph_Blended(font, static_cast<ui16>(m_start + charIndex), { 255, 255, 255, 255 });
+                    glyphSurface = TTF_RenderGlyph_Blended(font, static_cast<ui16>(glyph.character), { 255, 255, 255, 255 });
                     break;
             }
 
@@ -257,14 +333,14 @@ bool spg::Font::generate(       FontSize size,
 
             // Update the size of the glyph with what we rendered - there can be variance between this and what we obtained
             // in the glyph metric stage!
-            fontInstance.glyphs[charIndex].size.x = static_cast<f32>(glyphSurface->w);
-            fontInstance.glyphs[charIndex].size.y = static_cast<f32>(glyphSurface->h);
+            glyph.size.x = static_cast<f32>(glyphSurface->w);
+            glyph.size.y = static_cast<f32>(glyphSurface->h);
 
             // Build the UV dimensions for the glyph.
-            fontInstance.glyphs[charIndex].uvDimensions.x =        (static_cast<f32>(currentU) / static_cast<f32>(bestWidth));
-            fontInstance.glyphs[charIndex].uvDimensions.y =        (static_cast<f32>(currentV) / static_cast<f32>(bestHeight));
-            fontInstance.glyphs[charIndex].uvDimensions.z = (static_cast<f32>(glyphSurface->w) / static_cast<f32>(bestWidth));
-            fontInstance.glyphs[charIndex].uvDimensions.w = (static_cast<f32>(glyphSurface->h) / static_cast<f32>(bestHeight));
+            glyph.uvDimensions.x =        (static_cast<f32>(currentU) / static_cast<f32>(bestWidth));
+            glyph.uvDimensions.y =        (static_cast<f32>(currentV) / static_cast<f32>(bestHeight));
+            glyph.uvDimensions.z = (static_cast<f32>(glyphSurface->w) / static_cast<f32>(bestWidth));
+            glyph.uvDimensions.w = (static_cast<f32>(glyphSurface->h) / static_cast<f32>(bestHeight));
 
             // Update currentU.
             currentU += glyphSurface->w + padding;
@@ -301,7 +377,7 @@ spg::FontInstance spg::Font::getFontInstance(       FontSize size,
     }
 }
 
-spg::Font::Row* spg::Font::generateRows(Glyph* glyphs, ui32 rowCount, FontSize padding, ui32& width, ui32& height) {
+spg::Font::Row* spg::Font::generateRows(Glyph* const* glyphs, ui32 glyphCount, ui32 rowCount, FontSize padding, ui32& width, ui32& height) {
     // Create some arrays for the rows, their widths and max height of a glyph within each of them.
     //    Max heights are stored inside Row - it is a pair of max height and a vector of glyph indices.
     Row*  rows          = new Row[rowCount]();
@@ -317,9 +393,9 @@ spg::Font::Row* spg::Font::generateRows(Glyph* glyphs, ui32 rowCount, FontSize p
 
     // For each character, we now determine which row to put it in, updating the width and
     // height variables as we go.
-    for (ui32 i = 0; i < static_cast<ui32>(m_end - m_start); ++i) {
+    for (ui32 i = 0; i < glyphCount; ++i) {
         // Skip unsupported glyphs.
-        if (!glyphs[i].supported) continue;
+        if (!glyphs[i]->supported) continue;
 
         // Determine which row currently has the least width: this is the row we will add
         // the currently considered glyph to.
@@ -331,7 +407,7 @@ spg::Font::Row* spg::Font::generateRows(Glyph* glyphs, ui32 rowCount, FontSize p
         }
 
         // Update the width of the row we have chosen to add the glyph to.
-        currentWidths[bestRow] += glyphs[i].size.x + padding;
+        currentWidths[bestRow] += glyphs[i]->size.x + padding;
 
         // Update the overall width of the rectangle the rows form,
         // if our newly enlarged row exceeds it.
@@ -339,10 +415,10 @@ spg::Font::Row* spg::Font::generateRows(Glyph* glyphs, ui32 rowCount, FontSize p
 
         // Update the max height of our row if the new glyph exceeds it, and update
         // the height of the rectange the rows form.
-        if (rows[bestRow].first < glyphs[i].size.y) {
+        if (rows[bestRow].first < glyphs[i]->size.y) {
             height -= rows[bestRow].first;
-            height += glyphs[i].size.y;
-            rows[bestRow].first = glyphs[i].size.y;
+            height += glyphs[i]->size.y;
+            rows[bestRow].first = glyphs[i]->size.y;
         }
 
         rows[bestRow].second.push_back(i);
@@ -365,7 +441,7 @@ void spg::FontCache::dispose() {
     Fonts().swap(m_fonts);
 }
 
-bool spg::FontCache::registerFont(const char* name, const char* filepath, char start, char end) {
+bool spg::FontCache::registerFont(const char* name, const char* filepath, char32_t start, char32_t end) {
     // Try to emplace a new Font object with the given name.
     auto [_, added] = m_fonts.try_emplace(name, Font());
     // If we added it, then initialise the Font object.
@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "graphics/FrameArena.h"
+
+#include <cstdint>
+
+spg::FrameArena::FrameArena() :
+    m_offset(0),
+    m_used(0)
+{
+    /* Empty */
+}
+
+spg::FrameArena::~FrameArena() {
+    dispose();
+}
+
+void* spg::FrameArena::allocate(size_t bytes, size_t alignment /*= alignof(std::max_align_t)*/) {
+    // Align the address rather than the offset, so alignments beyond what new gives blocks are honoured too.
+    if (!m_blocks.empty()) {
+        Block& block = m_blocks.back();
+
+        uintptr_t address = reinterpret_cast<uintptr_t>(block.data + m_offset);
+        size_t    padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+
+        if (m_offset + padding + bytes <= block.size) {
+            void* ptr = block.data + m_offset + padding;
+            m_offset += padding + bytes;
+            return ptr;
+        }
+    }
+
+    // Otherwise start a new block, with room enough to align within.
+    addBlock(bytes + alignment);
+
+    return allocate(bytes, alignment);
+}
+
+void spg::FrameArena::reset() {
+    // Merge blocks so the next phase fits in one, and so never needs to allocate.
+    if (m_blocks.size() > 1) {
+        size_t capacity = getCapacity();
+
+        dispose();
+        addBlock(capacity);
+    }
+
+    m_offset = 0;
+    m_used   = 0;
+}
+
+void spg::FrameArena::dispose() {
+    for (auto& block : m_blocks) {
+        delete[] block.data;
+    }
+    std::vector<Block>().swap(m_blocks);
+
+    m_offset = 0;
+    m_used   = 0;
+}
+
+size_t spg::FrameArena::getCapacity() const {
+    size_t capacity = 0;
+    for (auto& block : m_blocks) {
+        capacity += block.size;
+    }
+
+    return capacity;
+}
+
+void spg::FrameArena::addBlock(size_t minimumSize) {
+    // Grow geometrically, so an arena settles on its final size after only a few phases.
+    size_t size = DEFAULT_FRAME_ARENA_BLOCK_SIZE;
+    if (!m_blocks.empty()) {
+        m_used += m_offset;
+        size    = m_blocks.back().size * 2;
+    }
+    size = std::max(size, minimumSize);
+
+    m_blocks.emplace_back(Block{ new ui8[size], size });
+    m_offset = 0;
+}
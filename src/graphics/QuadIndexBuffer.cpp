@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "graphics/QuadIndexBuffer.h"
+
+#define VERTICES_PER_QUAD 4
+#define INDICES_PER_QUAD  6
+
+// The number of bytes taken by the 16-bit indices, after which the 32-bit indices begin.
+#define SHORT_INDICES_SIZE (MAX_SHORT_INDEXED_QUADS * INDICES_PER_QUAD * sizeof(ui16))
+
+GLuint spg::QuadIndexBuffer::s_id       = 0;
+ui32   spg::QuadIndexBuffer::s_refCount = 0;
+ui32   spg::QuadIndexBuffer::s_maxQuads = DEFAULT_MAX_INDEXED_QUADS;
+ui64   spg::QuadIndexBuffer::s_bytesUploaded   = 0;
+ui32   spg::QuadIndexBuffer::s_generationCount = 0;
+
+/**
+ * @brief Fills the given buffer with the indices of the given number of quads.
+ *
+ * @param indices The buffer to fill.
+ * @param quadCount The number of quads to fill the indices of.
+ */
+template <typename IndexType>
+static void fillQuadIndices(IndexType* indices, ui32 quadCount) {
+    ui32 i = 0; // Index cursor.
+    ui32 v = 0; // Vertex cursor.
+    for (ui32 quad = 0; quad < quadCount; ++quad) {
+        // For each quad, we have four vertices which we write 6 indices for - giving us two triangles.
+        // The order of these indices is important - each triple should form a triangle correlating
+        // to the build functions.
+        indices[i++] = static_cast<IndexType>(v);     // Top left vertex.
+        indices[i++] = static_cast<IndexType>(v + 2); // Bottom left vertex.
+        indices[i++] = static_cast<IndexType>(v + 3); // Bottom right vertex.
+        indices[i++] = static_cast<IndexType>(v + 3); // Bottom right vertex.
+        indices[i++] = static_cast<IndexType>(v + 1); // Top right vertex.
+        indices[i++] = static_cast<IndexType>(v);     // Top left vertex.
+
+        v += VERTICES_PER_QUAD;
+    }
+}
+
+GLuint spg::QuadIndexBuffer::acquire() {
+    if (s_refCount++ == 0) {
+        glGenBuffers(1, &s_id);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_id);
+        generate();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    return s_id;
+}
+
+void spg::QuadIndexBuffer::release() {
+    if (s_refCount == 0) return;
+
+    if (--s_refCount == 0) {
+        glDeleteBuffers(1, &s_id);
+        s_id = 0;
+    }
+}
+
+void spg::QuadIndexBuffer::setMaxQuads(ui32 maxQuads) {
+    maxQuads = std::max(maxQuads, MAX_SHORT_INDEXED_QUADS);
+
+    bool grow = maxQuads > s_maxQuads;
+
+    s_maxQuads = maxQuads;
+
+    // Regenerate into the same buffer, so that vertex arrays with it bound still see it.
+    if (grow && s_id != 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_id);
+        generate();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
+
+ui32 spg::QuadIndexBuffer::draw(ui32 quadCount, GLint baseVertex) {
+    // Most draws are small enough for 16-bit indices, halving the index data read.
+    if (quadCount <= MAX_SHORT_INDEXED_QUADS) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(quadCount * INDICES_PER_QUAD), GL_UNSIGNED_SHORT,
+                                    nullptr, baseVertex);
+        return 1;
+    }
+
+    // Otherwise use the 32-bit indices, splitting into several draws if we have more quads
+    // than the indices cover.
+    ui32 drawCalls = 0;
+    while (quadCount > 0) {
+        ui32 drawCount = std::min(quadCount, s_maxQuads);
+
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(drawCount * INDICES_PER_QUAD), GL_UNSIGNED_INT,
+                                    reinterpret_cast<const GLvoid*>(SHORT_INDICES_SIZE), baseVertex);
+
+        quadCount  -= drawCount;
+        baseVertex += static_cast<GLint>(drawCount * VERTICES_PER_QUAD);
+        ++drawCalls;
+    }
+
+    return drawCalls;
+}
+
+void spg::QuadIndexBuffer::generate() {
+    size_t longIndicesSize = static_cast<size_t>(s_maxQuads) * INDICES_PER_QUAD * sizeof(ui32);
+    size_t size            = SHORT_INDICES_SIZE + longIndicesSize;
+
+    // Build both sets of indices into one local buffer, and send it over to the GPU. These
+    // never change after, so we tell OpenGL as much.
+    ui8* indices = new ui8[size];
+
+    fillQuadIndices(reinterpret_cast<ui16*>(indices), MAX_SHORT_INDEXED_QUADS);
+    fillQuadIndices(reinterpret_cast<ui32*>(indices + SHORT_INDICES_SIZE), s_maxQuads);
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(size), indices, GL_STATIC_DRAW);
+
+    s_bytesUploaded += size;
+    ++s_generationCount;
+
+    delete[] indices;
+}
@@ -0,0 +1,207 @@
+#include "stdafx.h"
+#include "graphics/SoftwareRenderDevice.h"
+
+#include "io/ImageIO.h"
+
+#define VERTICES_PER_QUAD 4
+
+/**
+ * @brief Determines the signed area of the parallelogram spanned by the edge from a to b
+ * and the point p - positive if p lies to the left of the edge.
+ */
+static f32 edgeFunction(const f32v2& a, const f32v2& b, const f32v2& p) {
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+/**
+ * @brief Determines if the edge from a to b is a top or left edge of a triangle wound
+ * anti-clockwise (with y up). Pixel centres lying exactly on an edge are only drawn for
+ * top and left edges, so that pixels on an edge shared by two triangles are drawn once.
+ */
+static bool isTopLeftEdge(const f32v2& a, const f32v2& b) {
+    return (a.y == b.y && b.x < a.x) || b.y < a.y;
+}
+
+spg::SoftwareRenderDevice::SoftwareRenderDevice() :
+    m_dimensions(0),
+    m_nextTexture(1)
+{
+    /* Empty */
+}
+
+void spg::SoftwareRenderDevice::init(ui32v2 dimensions) {
+    m_dimensions = dimensions;
+
+    size_t pixelCount = static_cast<size_t>(dimensions.x) * dimensions.y;
+    m_colour.resize(pixelCount);
+    m_depth.resize(pixelCount);
+
+    clear();
+}
+
+void spg::SoftwareRenderDevice::dispose() {
+    m_dimensions = ui32v2(0);
+
+    std::vector<colour4>().swap(m_colour);
+    std::vector<f32>().swap(m_depth);
+
+    std::unordered_map<GLuint, Texture>().swap(m_textures);
+    m_nextTexture = 1;
+}
+
+void spg::SoftwareRenderDevice::clear(colour4 colour /*= { 0, 0, 0, 255 }*/, f32 depth /*= 1.0f*/) {
+    std::fill(m_colour.begin(), m_colour.end(), colour);
+    std::fill(m_depth.begin(),  m_depth.end(),  depth);
+}
+
+GLuint spg::SoftwareRenderDevice::createTexture(ui32v2 dimensions, const void* pixels) {
+    GLuint id = m_nextTexture++;
+
+    Texture& texture   = m_textures[id];
+    texture.dimensions = dimensions;
+    texture.texels.resize(static_cast<size_t>(dimensions.x) * dimensions.y);
+
+    std::memcpy(texture.texels.data(), pixels, texture.texels.size() * sizeof(colour4));
+
+    return id;
+}
+
+void spg::SoftwareRenderDevice::destroyTexture(GLuint texture) {
+    m_textures.erase(texture);
+}
+
+void spg::SoftwareRenderDevice::render(const RenderFrame& frame) {
+    const f32m4 transform = frame.viewProjection * frame.worldProjection;
+    const i32v4 viewport(0, 0, static_cast<i32>(m_dimensions.x), static_cast<i32>(m_dimensions.y));
+
+    // Takes a vertex through to window coordinates, normalising its colour as OpenGL would.
+    auto toRaster = [&](const SpriteVertex& vertex) {
+        f32v4 clip = transform * f32v4(vertex.position, 1.0f);
+
+        RasterVertex result;
+        result.position.x       = (clip.x / clip.w * 0.5f + 0.5f) * static_cast<f32>(m_dimensions.x);
+        result.position.y       = (clip.y / clip.w * 0.5f + 0.5f) * static_cast<f32>(m_dimensions.y);
+        result.depth            = clip.z / clip.w * 0.5f + 0.5f;
+        result.relativePosition = vertex.relativePosition;
+        result.colour           = f32v4(vertex.colour.r, vertex.colour.g, vertex.colour.b, vertex.colour.a) / 255.0f;
+        return result;
+    };
+
+    // As with OpenGL, opaque batches are drawn first without blending, and then the rest blended over them.
+    for (bool opaque : { true, false }) {
+        for (size_t b = 0; b < frame.batchCount; ++b) {
+            const SpriteBatch& batch = frame.batches[b];
+            if (batch.opaque != opaque) continue;
+
+            auto it = m_textures.find(batch.textures[0]);
+            if (it == m_textures.end()) continue;
+
+            // Draw within the batch's clip rectangle if it has one, otherwise the whole viewport.
+            i32v4 scissor(0, 0, viewport.z, viewport.w);
+            if (batch.clipIndex != NO_CLIP) {
+                i32v4 clip = projectClipRect(frame.clipStack->getRect(batch.clipIndex), transform, viewport);
+
+                scissor = i32v4(std::max(clip.x, 0), std::max(clip.y, 0),
+                                    std::min(clip.x + clip.z, viewport.z), std::min(clip.y + clip.w, viewport.w));
+            }
+
+            for (ui32 s = 0; s < batch.spriteCount; ++s) {
+                const SpriteVertex* quad = frame.vertices + static_cast<size_t>(batch.spriteOffset + s) * VERTICES_PER_QUAD;
+
+                RasterVertex topLeft     = toRaster(quad[0]);
+                RasterVertex topRight    = toRaster(quad[1]);
+                RasterVertex bottomLeft  = toRaster(quad[2]);
+                RasterVertex bottomRight = toRaster(quad[3]);
+
+                // The same two triangles as given by the quad index buffer.
+                drawTriangle(topLeft,     bottomLeft, bottomRight, quad[0].uvDimensions, it->second, scissor, !opaque);
+                drawTriangle(bottomRight, topRight,   topLeft,     quad[0].uvDimensions, it->second, scissor, !opaque);
+            }
+        }
+    }
+}
+
+bool spg::SoftwareRenderDevice::save(const char* filepath) const {
+    return spio::Image::PNG::save(filepath, m_colour.data(), m_dimensions, spio::Image::PixelFormat::RGBA_UI8);
+}
+
+void spg::SoftwareRenderDevice::drawTriangle(RasterVertex a, RasterVertex b, RasterVertex c, const f32v4& uvDimensions,
+                                                const Texture& texture, const i32v4& scissor, bool blend) {
+    // Wind every triangle anti-clockwise, so that inside is always to the left of each edge.
+    f32 area = edgeFunction(a.position, b.position, c.position);
+    if (area == 0.0f) return;
+    if (area < 0.0f) {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    const bool topLeftA = isTopLeftEdge(b.position, c.position);
+    const bool topLeftB = isTopLeftEdge(c.position, a.position);
+    const bool topLeftC = isTopLeftEdge(a.position, b.position);
+
+    // Only visit the pixels whose centres could lie in both the triangle and the scissor rectangle.
+    i32 minX = std::max(scissor.x, static_cast<i32>(std::floor(std::min({ a.position.x, b.position.x, c.position.x }))));
+    i32 minY = std::max(scissor.y, static_cast<i32>(std::floor(std::min({ a.position.y, b.position.y, c.position.y }))));
+    i32 maxX = std::min(scissor.z, static_cast<i32>(std::ceil(std::max({ a.position.x, b.position.x, c.position.x }))));
+    i32 maxY = std::min(scissor.w, static_cast<i32>(std::ceil(std::max({ a.position.y, b.position.y, c.position.y }))));
+
+    const f32 texWidth  = static_cast<f32>(texture.dimensions.x);
+    const f32 texHeight = static_cast<f32>(texture.dimensions.y);
+
+    for (i32 y = minY; y < maxY; ++y) {
+        for (i32 x = minX; x < maxX; ++x) {
+            f32v2 centre(static_cast<f32>(x) + 0.5f, static_cast<f32>(y) + 0.5f);
+
+            // Each weight is that of the vertex opposite the edge it is measured from.
+            f32 wa = edgeFunction(b.position, c.position, centre);
+            f32 wb = edgeFunction(c.position, a.position, centre);
+            f32 wc = edgeFunction(a.position, b.position, centre);
+
+            bool inside = (wa > 0.0f || (wa == 0.0f && topLeftA))
+                            && (wb > 0.0f || (wb == 0.0f && topLeftB))
+                            && (wc > 0.0f || (wc == 0.0f && topLeftC));
+            if (!inside) continue;
+
+            wa /= area;
+            wb /= area;
+            wc /= area;
+
+            // Rows of the buffers go from top to bottom, while window coordinates go up.
+            size_t pixel = static_cast<size_t>(m_dimensions.y - 1 - static_cast<ui32>(y)) * m_dimensions.x + static_cast<size_t>(x);
+
+            f32 depth = a.depth * wa + b.depth * wb + c.depth * wc;
+            if (depth >= m_depth[pixel]) continue;
+
+            f32v2 relativePosition = a.relativePosition * wa + b.relativePosition * wb + c.relativePosition * wc;
+            f32v4 colour           = a.colour * wa + b.colour * wb + c.colour * wc;
+
+            // Sample the nearest texel, repeating the texture.
+            f32 u = relativePosition.x * uvDimensions.z + uvDimensions.x;
+            f32 v = relativePosition.y * uvDimensions.w + uvDimensions.y;
+
+            f32 tx = std::floor((u - std::floor(u)) * texWidth);
+            f32 ty = std::floor((v - std::floor(v)) * texHeight);
+
+            size_t texel = static_cast<size_t>(std::min(ty, texHeight - 1.0f)) * texture.dimensions.x
+                                + static_cast<size_t>(std::min(tx, texWidth - 1.0f));
+
+            const colour4& sample = texture.texels[texel];
+            colour = colour * f32v4(sample.r, sample.g, sample.b, sample.a) / 255.0f;
+
+            colour4& destination = m_colour[pixel];
+            if (blend) {
+                f32 alpha = colour.a;
+                colour = colour * alpha
+                            + f32v4(destination.r, destination.g, destination.b, destination.a) / 255.0f * (1.0f - alpha);
+            }
+
+            destination = colour4(
+                static_cast<ui8>(glm::clamp(colour.r, 0.0f, 1.0f) * 255.0f + 0.5f),
+                static_cast<ui8>(glm::clamp(colour.g, 0.0f, 1.0f) * 255.0f + 0.5f),
+                static_cast<ui8>(glm::clamp(colour.b, 0.0f, 1.0f) * 255.0f + 0.5f),
+                static_cast<ui8>(glm::clamp(colour.a, 0.0f, 1.0f) * 255.0f + 0.5f)
+            );
+            m_depth[pixel] = depth;
+        }
+    }
+}
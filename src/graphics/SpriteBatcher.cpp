@@ -1,21 +1,57 @@
 #include "stdafx.h"
 #include "graphics/SpriteBatcher.h"
 
+#include "debug/Profiler.h"
 #include "graphics/Clipping.hpp"
 #include "graphics/Font.h"
+#include "graphics/QuadIndexBuffer.h"
+#include "graphics/RadixSort.hpp"
+#include "graphics/RenderDevice.h"
+#include "graphics/SpriteLayer.h"
 
 #include "graphics/StringDrawers.inl"
 
+#include <chrono>
+
 #define VERTICES_PER_QUAD 4
-#define INDICES_PER_QUAD  6
+
+// The fewest sprites worth building across a worker pool, and how many each worker takes at a time.
+#define PARALLEL_BUILD_THRESHOLD  4096
+#define PARALLEL_BUILD_CHUNK_SIZE 1024
+
+/**
+ * @brief Reads the steady clock in nanoseconds, for timing the stages of a frame.
+ */
+static ui64 clockNanoseconds() {
+    return static_cast<ui64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
 
 spg::SpriteBatcher::SpriteBatcher() :
+    m_sortMode(SpriteSortMode::TEXTURE),
+    m_culling(false),
+    m_cullRect(0.0f),
+    m_clipTransform(1.0f),
+    m_viewport(0),
     m_vao(0), m_vbo(0), m_ibo(0),
     m_usageHint(GL_STATIC_DRAW),
-    m_indexCount(0),
+    m_uploadMode(SpriteUploadMode::ORPHAN),
+    m_renderMode(SpriteRenderMode::QUADS),
+    m_textureMode(SpriteTextureMode::SINGLE),
+    m_maxBatchTextures(1),
+    m_vertexFormat(SpriteVertexFormat::STANDARD),
+    m_bufferOffset(0),
+    m_workerPool(nullptr),
+    m_drawContextCount(0),
+    m_device(nullptr),
     m_defaultTexture(0),
     m_activeShader(nullptr),
-    m_fontCache(nullptr)
+    m_fontCache(nullptr),
+    m_stats(),
+    m_vboSize(0),
+    m_indexBytesCounted(0),
+    m_indexGenerationsCounted(0)
 {
     /* Empty */
 }
@@ -23,9 +59,21 @@ spg::SpriteBatcher::~SpriteBatcher() {
     /* Empty */
 }
 
-void spg::SpriteBatcher::init(FontCache* fontCache, GLenum usageHint /*= GL_STATIC_DRAW*/) {
-    m_fontCache = fontCache;
-    m_usageHint = usageHint;
+void spg::SpriteBatcher::init(         FontCache* fontCache,
+                                           GLenum usageHint    /*= GL_STATIC_DRAW*/,
+                                 SpriteUploadMode uploadMode   /*= SpriteUploadMode::ORPHAN*/,
+                                 SpriteRenderMode renderMode   /*= SpriteRenderMode::QUADS*/,
+                                SpriteTextureMode textureMode  /*= SpriteTextureMode::SINGLE*/,
+                               SpriteVertexFormat vertexFormat /*= SpriteVertexFormat::STANDARD*/) {
+    m_fontCache    = fontCache;
+    m_usageHint    = usageHint;
+    m_uploadMode   = uploadMode;
+    m_renderMode   = renderMode;
+    m_textureMode  = textureMode;
+    // Instances have a format of their own, so the vertex format only matters for quads.
+    m_vertexFormat = renderMode == SpriteRenderMode::QUADS ? vertexFormat : SpriteVertexFormat::STANDARD;
+
+    m_textLayoutCache.init();
 
     /*****************************\
      * Create a default shader . *
@@ -35,14 +83,38 @@ void spg::SpriteBatcher::init(FontCache* fontCache, GLenum usageHint /*= GL_STAT
     m_defaultShader.init();
 
     // Set each attribute's corresponding index.
-    m_defaultShader.setAttribute("vPosition",         SpriteShaderAttribID::POSITION);
-    m_defaultShader.setAttribute("vRelativePosition", SpriteShaderAttribID::RELATIVE_POSITION);
-    m_defaultShader.setAttribute("vUVDimensions",     SpriteShaderAttribID::UV_DIMENSIONS);
-    m_defaultShader.setAttribute("vColour",           SpriteShaderAttribID::COLOUR);
+    setShaderAttributes(&m_defaultShader);
 
     // TODO(Matthew): Handle errors.
     // Add the shaders to the program.
-    m_defaultShader.addShaders("shaders/DefaultSprite.vert", "shaders/DefaultSprite.frag");
+    //     When instancing, the vertex shader is responsible for expanding each instance into
+    //     a quad, but the fragment shader is unchanged. With texture arrays, the fragment
+    //     shader must pick between a plain texture and a layer of a texture array, while
+    //     with multiple texture units it must pick between the textures of each unit.
+    //     The compact vertex shader hands the fragment shader its texture coordinates in
+    //     such a way that the fragment shaders need no variant of their own.
+    const char* vertexShader = "shaders/DefaultSprite.vert";
+    if (m_renderMode == SpriteRenderMode::INSTANCED) {
+        vertexShader = "shaders/DefaultSpriteInstanced.vert";
+    } else if (m_vertexFormat == SpriteVertexFormat::COMPACT) {
+        vertexShader = "shaders/DefaultSpriteCompact.vert";
+    }
+    const char* fragmentShader = "shaders/DefaultSprite.frag";
+    if (m_textureMode == SpriteTextureMode::ARRAY) {
+        fragmentShader = "shaders/DefaultSpriteArray.frag";
+    } else if (m_textureMode == SpriteTextureMode::MULTI_UNIT) {
+        fragmentShader = "shaders/DefaultSpriteMultiUnit.frag";
+    }
+    m_defaultShader.addShaders(vertexShader, fragmentShader);
+
+    // Find out how many textures we can bind at once, if we are going to.
+    m_maxBatchTextures = 1;
+    if (m_textureMode == SpriteTextureMode::MULTI_UNIT) {
+        GLint textureUnits;
+        glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &textureUnits);
+
+        m_maxBatchTextures = std::min(MAX_BATCH_TEXTURES, static_cast<ui32>(textureUnits));
+    }
 
     // Link program (i.e. send to GPU).
     m_defaultShader.link();
@@ -60,31 +132,28 @@ void spg::SpriteBatcher::init(FontCache* fontCache, GLenum usageHint /*= GL_STAT
 
     // Generate the associated vertex & index buffers - these are the bits of memory that will be populated within the GPU storing information
     // about the graphics we want to draw.
-    glGenBuffers(1, &m_vbo);
-    glGenBuffers(1, &m_ibo);
+    //     In streaming mode, the vertex buffer is owned by our streaming buffer which creates it on first use.
+    if (m_uploadMode == SpriteUploadMode::STREAMING) {
+        m_streamingBuffer.init(GL_ARRAY_BUFFER);
+    } else {
+        glGenBuffers(1, &m_vbo);
+    }
+    // The index buffer is shared by all sprite batchers, being the same for every set of quads.
+    m_ibo = QuadIndexBuffer::acquire();
 
-    // Bind those buffers
+    // Bind the index buffer
     //    OpenGL generally follows a pattern of generate an ID corresponding to some memory on the GPU, bind said memory, link some properties to them 
     //    (such as how the data in the memory correspond to variables inside our shader programs).
-    glBindBuffer(GL_ARRAY_BUFFER,         m_vbo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
 
     // Enable the attributes in our shader.
     m_defaultShader.enableVertexAttribArrays();
 
-    // Connect the vertex attributes in the shader (e.g. vPosition) to its corresponding chunk of memory inside the SpriteVertex struct.
-    //     We first tell OpenGL the ID of the attribute within the shader (as we set earlier), then the number of values and their type.
-    //
-    //     After that, we tell OpenGL whether that data should be normalised (e.g. unsigned bytes that need normalising will be converted 
-    //     to a float divided through by 255.0f and by OpenGL - so that colours, e.g., are represented by values between 0.0f and 1.0f 
-    //     per R/G/B/A channel rather than the usual 0 to 255).
-    //
-    //     We then pass the size of the data representing a vertex followed by how many bytes into that data the value is stored - we use offset rather than 
-    //     manually writing this to give us flexibility in changing the order of the SpriteVertex struct.
-    glVertexAttribPointer(SpriteShaderAttribID::POSITION,          3, GL_FLOAT,         false, sizeof(SpriteVertex), reinterpret_cast<void*>(offsetof(SpriteVertex, position)));
-    glVertexAttribPointer(SpriteShaderAttribID::RELATIVE_POSITION, 2, GL_FLOAT,         false, sizeof(SpriteVertex), reinterpret_cast<void*>(offsetof(SpriteVertex, relativePosition)));
-    glVertexAttribPointer(SpriteShaderAttribID::UV_DIMENSIONS,     4, GL_FLOAT,         false, sizeof(SpriteVertex), reinterpret_cast<void*>(offsetof(SpriteVertex, uvDimensions)));
-    glVertexAttribPointer(SpriteShaderAttribID::COLOUR,            4, GL_UNSIGNED_BYTE, true,  sizeof(SpriteVertex), reinterpret_cast<void*>(offsetof(SpriteVertex, colour)));
+    // Link our vertex buffer to the attributes of our shaders - in streaming mode we must wait until the buffer exists.
+    if (m_uploadMode != SpriteUploadMode::STREAMING) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        setVertexAttribPointers(0);
+    }
 
     // Clean everything up, unbinding each of our buffers and the vertex array.
     glBindVertexArray(0);
@@ -112,6 +181,42 @@ void spg::SpriteBatcher::init(FontCache* fontCache, GLenum usageHint /*= GL_STAT
 
     // Unbind our complete texture.
     glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Being pure white, the default texture is of course opaque.
+    m_opaqueTextures.insert(m_defaultTexture);
+
+    // Let our draw contexts know of the default texture too.
+    for (auto& context : m_drawContexts) {
+        context.m_defaultTexture = m_defaultTexture;
+    }
+
+#if defined(SP_PROFILING)
+    m_gpuTimer.init();
+#endif
+}
+
+void spg::SpriteBatcher::init(FontCache* fontCache, RenderDevice* device) {
+    m_fontCache = fontCache;
+    m_device    = device;
+
+    // The device is handed plain quads, so we keep to the default modes, which are all it understands.
+    m_uploadMode       = SpriteUploadMode::ORPHAN;
+    m_renderMode       = SpriteRenderMode::QUADS;
+    m_textureMode      = SpriteTextureMode::SINGLE;
+    m_maxBatchTextures = 1;
+    m_vertexFormat     = SpriteVertexFormat::STANDARD;
+
+    m_textLayoutCache.init();
+
+    // Create the default white texture through the device instead.
+    colour4 pix = { 255, 255, 255, 255 };
+    m_defaultTexture = m_device->createTexture(ui32v2(1), &pix);
+
+    m_opaqueTextures.insert(m_defaultTexture);
+
+    for (auto& context : m_drawContexts) {
+        context.m_defaultTexture = m_defaultTexture;
+    }
 }
 
 void spg::SpriteBatcher::dispose() {
@@ -122,29 +227,77 @@ void spg::SpriteBatcher::dispose() {
     }
 
     if (m_ibo != 0) {
-        glDeleteBuffers(1, &m_ibo);
+        QuadIndexBuffer::release();
         m_ibo = 0;
-        m_indexCount = 0;
     }
 
+    m_streamingBuffer.dispose();
+    m_textureArrays.dispose();
+
+#if defined(SP_PROFILING)
+    m_gpuTimer.dispose();
+#endif
+
     if (m_vao != 0) {
         glDeleteVertexArrays(1, &m_vao);
         m_vao = 0;
     }
 
-    // Delete our default texture.
+    // Delete our default texture, from whichever of the device or OpenGL created it.
     if (m_defaultTexture != 0) {
-        glDeleteTextures(1, &m_defaultTexture);
+        if (m_device != nullptr) {
+            m_device->destroyTexture(m_defaultTexture);
+        } else {
+            glDeleteTextures(1, &m_defaultTexture);
+        }
         m_defaultTexture = 0;
     }
 
+    m_device = nullptr;
+    std::vector<ui8>().swap(m_deviceVertices);
+
+    std::unordered_set<GLuint>().swap(m_opaqueTextures);
+
     // Reset properties and stored sprites & batches.
-    m_usageHint  = GL_STATIC_DRAW;
-    m_indexCount = 0;
+    m_usageHint        = GL_STATIC_DRAW;
+    m_uploadMode       = SpriteUploadMode::ORPHAN;
+    m_renderMode       = SpriteRenderMode::QUADS;
+    m_textureMode      = SpriteTextureMode::SINGLE;
+    m_maxBatchTextures = 1;
+    m_vertexFormat     = SpriteVertexFormat::STANDARD;
+    m_bufferOffset     = 0;
+    m_sortMode         = SpriteSortMode::TEXTURE;
+    m_culling          = false;
+    m_cullRect         = f32v4(0.0f);
+    m_stats            = {};
+    m_vboSize          = 0;
 
     Sprites().swap(m_sprites);
     SpritePtrs().swap(m_spritePtrs);
     Batches().swap(m_batches);
+
+    std::vector<ui64>().swap(m_sortKeys);
+    std::vector<ui64>().swap(m_sortKeysScratch);
+    std::vector<ui32>().swap(m_sortIndices);
+    std::vector<ui32>().swap(m_sortIndicesScratch);
+    std::vector<ui32>().swap(m_cullIndices);
+
+    m_clipStack.dispose();
+    m_frameArena.dispose();
+    m_textLayoutCache.dispose();
+
+    TextureIndices().swap(m_textureIndices);
+
+    std::vector<SpriteLayer*>().swap(m_layers);
+
+    for (auto& context : m_drawContexts) {
+        Sprites().swap(context.m_sprites);
+        context.m_clipStack.dispose();
+        context.m_frameArena.dispose();
+        context.m_textLayout = TextLayout{};
+        context.m_defaultTexture = 0;
+    }
+    m_drawContextCount.store(0);
 }
 
 void spg::SpriteBatcher::reserve(size_t count) {
@@ -154,9 +307,51 @@ void spg::SpriteBatcher::reserve(size_t count) {
     }
 }
 
+void spg::SpriteBatcher::setTextureOpaque(GLuint texture, bool opaque /*= true*/) {
+    if (opaque) {
+        m_opaqueTextures.insert(texture);
+    } else {
+        m_opaqueTextures.erase(texture);
+    }
+}
+
+bool spg::SpriteBatcher::registerArrayTexture(GLuint texture) {
+    if (m_textureMode != SpriteTextureMode::ARRAY) return false;
+
+    return m_textureArrays.add(texture);
+}
+
 void spg::SpriteBatcher::begin() {
+    SP_PROFILE_ZONE("SpriteBatcher::begin");
+
     m_sprites.clear();
     m_batches.clear();
+    m_clipStack.clear();
+
+    // Anything allocated from the arenas last phase has been drawn by now.
+    m_frameArena.reset();
+
+    // Start the frame's counters afresh. The shared index buffer's counters run for the life of the process,
+    // so we note where they are now to count only the uploads made from here on.
+    m_stats                   = {};
+    m_indexBytesCounted       = QuadIndexBuffer::getBytesUploaded();
+    m_indexGenerationsCounted = QuadIndexBuffer::getGenerationCount();
+
+    // Throw away anything left in draw contexts from a batching phase that was never ended.
+    for (auto& context : m_drawContexts) {
+        context.m_sprites.clear();
+        context.m_clipStack.clear();
+        context.m_frameArena.reset();
+    }
+    m_drawContextCount.store(0);
+}
+
+spg::SpriteBatcher::DrawContext* spg::SpriteBatcher::acquireDrawContext() {
+    // Each caller gets its own index, so no two threads can be handed the same context.
+    ui32 index = m_drawContextCount.fetch_add(1);
+    if (index >= MAX_DRAW_CONTEXTS) return nullptr;
+
+    return &m_drawContexts[index];
 }
 
 void spg::SpriteBatcher::draw(Sprite&& sprite) {
@@ -166,6 +361,7 @@ void spg::SpriteBatcher::draw(Sprite&& sprite) {
     if (spriteRef.texture == 0) {
         spriteRef.texture = m_defaultTexture;
     }
+    spriteRef.clipIndex = m_clipStack.getCurrent();
 }
 
 void spg::SpriteBatcher::draw( QuadBuilder builder,
@@ -186,7 +382,8 @@ void spg::SpriteBatcher::draw( QuadBuilder builder,
         uvRect,
         c1,
         c2,
-        gradient
+        gradient,
+        m_clipStack.getCurrent()
     });
 }
 
@@ -207,7 +404,8 @@ void spg::SpriteBatcher::draw(      GLuint texture,
         uvRect,
         c1,
         c2,
-        gradient
+        gradient,
+        m_clipStack.getCurrent()
     });
 }
 
@@ -248,46 +446,217 @@ void spg::SpriteBatcher::drawString( const char* str,
                                              f32 depth /*= 0.0f*/) {
     if (fontInstance == NIL_FONT_INSTANCE) return;
 
-    StringComponents components { std::make_pair(str, StringDrawProperties{ fontInstance, sizing, tint }) };
+    // A lone component lives on the stack, rather than in a vector on the heap.
+    StringComponent component = std::make_pair(str, StringDrawProperties{ fontInstance, sizing, tint });
 
-    drawString(components, rect, align, wrap, depth);
+    drawTextLayout(this, m_textLayoutCache.fetch(&m_frameArena, &component, 1, rect, align, wrap), f32v2(0.0f), depth);
 }
 
-void spg::SpriteBatcher::drawString(StringComponents components,
-                                               f32v4 rect,
-                                           TextAlign align /*= TextAlign::TOP_LEFT*/,
-                                            WordWrap wrap  /*= WordWrap::NONE*/,
-                                                 f32 depth /*= 0.0f*/) {
-    switch(wrap) {
-        case WordWrap::NONE:
-            drawNoWrapString(this, components, rect, align, depth);
-            break;
-        case WordWrap::QUICK:
-            drawQuickWrapString(this, components, rect, align, depth);
-            break;
-        case WordWrap::GREEDY:
-            drawGreedyWrapString(this, components, rect, align, depth);
-            break;
-        case WordWrap::MINIMUM_RAGGEDNESS:
-            // drawMinRagWrapString(this, components, rect, align, depth);
-            break;
+void spg::SpriteBatcher::drawString(const StringComponents& components,
+                                                     f32v4 rect,
+                                                 TextAlign align /*= TextAlign::TOP_LEFT*/,
+                                                  WordWrap wrap  /*= WordWrap::NONE*/,
+                                                       f32 depth /*= 0.0f*/) {
+    drawTextLayout(this, m_textLayoutCache.fetch(&m_frameArena, components.data(), components.size(), rect, align, wrap), f32v2(0.0f), depth);
+}
+
+void spg::SpriteBatcher::drawLayout(const TextLayout& layout, const f32v2& offset /*= f32v2(0.0f)*/, f32 depth /*= 0.0f*/) {
+    drawTextLayout(this, layout, offset, depth);
+}
+
+void spg::SpriteBatcher::layoutString( const char* str,
+                                             f32v4 rect,
+                                      StringSizing sizing,
+                                           colour4 tint,
+                                      FontInstance fontInstance,
+                                         TextAlign align,
+                                          WordWrap wrap,
+                                        TextLayout& layout) {
+    if (fontInstance == NIL_FONT_INSTANCE) {
+        layout.clear();
+        layout.rect = rect;
+        return;
     }
+
+    StringComponent component = std::make_pair(str, StringDrawProperties{ fontInstance, sizing, tint });
+
+    layoutStringComponents(&m_frameArena, &component, 1, rect, align, wrap, layout);
 }
 
-void spg::SpriteBatcher::end(SpriteSortMode sortMode /*= SpriteSortMode::TEXTURE*/) {
-    // Reserve the right amount of space to then assign a pointer for each sprite.
-    if (m_spritePtrs.size() != m_sprites.size()) {
-        m_spritePtrs.resize(m_sprites.size());
+void spg::SpriteBatcher::layoutString(const StringComponents& components,
+                                                       f32v4 rect,
+                                                   TextAlign align,
+                                                    WordWrap wrap,
+                                                  TextLayout& layout) {
+    layoutStringComponents(&m_frameArena, components.data(), components.size(), rect, align, wrap, layout);
+}
+
+f32v2 spg::SpriteBatcher::measureString( const char* str,
+                                        StringSizing sizing,
+                                        FontInstance fontInstance,
+                                                 f32 maxWidth /*= std::numeric_limits<f32>::max()*/,
+                                            WordWrap wrap     /*= WordWrap::NONE*/) {
+    if (fontInstance == NIL_FONT_INSTANCE) return f32v2(0.0f);
+
+    // Tint has no bearing on size, but is part of the key drawing the string would look the layout up by, so
+    // we take white as the most likely.
+    StringComponent component = std::make_pair(str, StringDrawProperties{ fontInstance, sizing, { 255, 255, 255, 255 } });
+
+    // Nothing is ever too tall to fit, so nothing is dropped from the measurement.
+    f32v4 rect(0.0f, 0.0f, maxWidth, std::numeric_limits<f32>::max());
+
+    return m_textLayoutCache.fetch(&m_frameArena, &component, 1, rect, TextAlign::TOP_LEFT, wrap).size;
+}
+
+f32v2 spg::SpriteBatcher::measureString(const StringComponents& components,
+                                                            f32 maxWidth /*= std::numeric_limits<f32>::max()*/,
+                                                       WordWrap wrap     /*= WordWrap::NONE*/) {
+    f32v4 rect(0.0f, 0.0f, maxWidth, std::numeric_limits<f32>::max());
+
+    return m_textLayoutCache.fetch(&m_frameArena, components.data(), components.size(), rect, TextAlign::TOP_LEFT, wrap).size;
+}
+
+void spg::SpriteBatcher::DrawContext::draw(Sprite&& sprite) {
+    m_sprites.emplace_back(std::forward<Sprite>(sprite));
+
+    Sprite& spriteRef = m_sprites.back();
+    if (spriteRef.texture == 0) {
+        spriteRef.texture = m_defaultTexture;
     }
-    for (size_t i = 0; i < m_sprites.size(); ++i) {
-        m_spritePtrs[i] = &m_sprites[i];
+    spriteRef.clipIndex = m_clipStack.getCurrent();
+}
+
+void spg::SpriteBatcher::DrawContext::draw( QuadBuilder builder,
+                                                 GLuint texture,
+                                           const f32v2& position,
+                                           const f32v2& size,
+                                                colour4 c1       /*= { 255, 255, 255, 255 }*/,
+                                                colour4 c2       /*= { 255, 255, 255, 255 }*/,
+                                               Gradient gradient /*= Gradient::NONE*/,
+                                                    f32 depth    /*= 0.0f*/,
+                                           const f32v4& uvRect   /*= f32v4(0.0f, 0.0f, 1.0f, 1.0f)*/) {
+    m_sprites.emplace_back(Sprite{
+        builder,
+        texture == 0 ? m_defaultTexture : texture,
+        position,
+        size,
+        depth,
+        uvRect,
+        c1,
+        c2,
+        gradient,
+        m_clipStack.getCurrent()
+    });
+}
+
+void spg::SpriteBatcher::DrawContext::draw(      GLuint texture,
+                                           const f32v2& position,
+                                           const f32v2& size,
+                                                colour4 c1       /*= { 255, 255, 255, 255 }*/,
+                                                colour4 c2       /*= { 255, 255, 255, 255 }*/,
+                                               Gradient gradient /*= Gradient::NONE*/,
+                                                    f32 depth    /*= 0.0f*/,
+                                           const f32v4& uvRect   /*= f32v4(0.0f, 0.0f, 1.0f, 1.0f)*/) {
+    m_sprites.emplace_back(Sprite{
+        &buildQuad,
+        texture == 0 ? m_defaultTexture : texture,
+        position,
+        size,
+        depth,
+        uvRect,
+        c1,
+        c2,
+        gradient,
+        m_clipStack.getCurrent()
+    });
+}
+
+void spg::SpriteBatcher::DrawContext::drawString( const char* str,
+                                                        f32v4 rect,
+                                                 StringSizing sizing,
+                                                      colour4 tint,
+                                                 FontInstance fontInstance,
+                                                    TextAlign align /*= TextAlign::TOP_LEFT*/,
+                                                     WordWrap wrap  /*= WordWrap::NONE*/,
+                                                          f32 depth /*= 0.0f*/) {
+    if (fontInstance == NIL_FONT_INSTANCE) return;
+
+    StringComponent component = std::make_pair(str, StringDrawProperties{ fontInstance, sizing, tint });
+
+    layoutStringComponents(&m_frameArena, &component, 1, rect, align, wrap, m_textLayout);
+    drawTextLayout(this, m_textLayout, f32v2(0.0f), depth);
+}
+
+void spg::SpriteBatcher::DrawContext::drawString(const StringComponents& components,
+                                                                  f32v4 rect,
+                                                              TextAlign align /*= TextAlign::TOP_LEFT*/,
+                                                               WordWrap wrap  /*= WordWrap::NONE*/,
+                                                                    f32 depth /*= 0.0f*/) {
+    layoutStringComponents(&m_frameArena, components.data(), components.size(), rect, align, wrap, m_textLayout);
+    drawTextLayout(this, m_textLayout, f32v2(0.0f), depth);
+}
+
+void spg::SpriteBatcher::DrawContext::drawLayout(const TextLayout& layout, const f32v2& offset /*= f32v2(0.0f)*/, f32 depth /*= 0.0f*/) {
+    drawTextLayout(this, layout, offset, depth);
+}
+
+void spg::SpriteBatcher::end(SpriteSortMode sortMode /*= SpriteSortMode::TEXTURE*/) {
+    SP_PROFILE_ZONE("SpriteBatcher::end");
+
+    // Merge in the sprites drawn to any draw contexts acquired this phase.
+    //     Counts beyond the maximum are from failed acquisitions, so we clamp.
+    ui32 contextCount = std::min(m_drawContextCount.load(), MAX_DRAW_CONTEXTS);
+    if (contextCount > 0) {
+        size_t spriteCount = m_sprites.size();
+        for (ui32 i = 0; i < contextCount; ++i) {
+            spriteCount += m_drawContexts[i].m_sprites.size();
+        }
+        m_sprites.reserve(spriteCount);
+
+        for (ui32 i = 0; i < contextCount; ++i) {
+            Sprites& sprites = m_drawContexts[i].m_sprites;
+
+            // The context's clip rectangles are recorded after ours, so its sprites' clip
+            // indices must be moved along by the same amount.
+            size_t first      = m_sprites.size();
+            ui32   clipOffset = m_clipStack.append(m_drawContexts[i].m_clipStack);
+
+            m_sprites.insert(m_sprites.end(), sprites.begin(), sprites.end());
+            if (clipOffset != 0) {
+                for (size_t j = first; j < m_sprites.size(); ++j) {
+                    if (m_sprites[j].clipIndex != NO_CLIP) m_sprites[j].clipIndex += clipOffset;
+                }
+            }
+
+            // Clearing keeps the context's capacity for the next phase.
+            sprites.clear();
+            m_drawContexts[i].m_clipStack.clear();
+        }
     }
+    m_drawContextCount.store(0);
+
+    m_stats.spritesSubmitted = static_cast<ui32>(m_sprites.size());
 
-    // Sort the sprites - we sort the vector of pointers only for speed.
-    sortSprites(sortMode);
+    // Drop any sprites that wouldn't be seen, before we spend any time sorting or building them.
+    if (m_culling) cullSprites(m_sprites);
+
+    m_stats.spritesCulled = m_stats.spritesSubmitted - static_cast<ui32>(m_sprites.size());
+
+    // Sort the sprites - this populates the vector of pointers in sorted order, leaving the
+    // sprites themselves where they are.
+    ui64 sortStart = clockNanoseconds();
+
+    m_sortMode = sortMode;
+    sortSprites(sortMode, m_sprites, m_spritePtrs);
+
+    m_stats.sortTime = clockNanoseconds() - sortStart;
 
     // Generate the batches to use for draw calls.
     generateBatches();
+
+    m_stats.batches = static_cast<ui32>(m_batches.size());
+
+    countIndexUploads();
 }
 
 bool spg::SpriteBatcher::setShader(GLSLProgram* shader /*= nullptr*/) {
@@ -297,10 +666,7 @@ bool spg::SpriteBatcher::setShader(GLSLProgram* shader /*= nullptr*/) {
         if (!shader->isInitialised()) return false;
 
         if (!shader->isLinked()) {
-            shader->setAttribute("vPosition",         SpriteShaderAttribID::POSITION);
-            shader->setAttribute("vRelativePosition", SpriteShaderAttribID::RELATIVE_POSITION);
-            shader->setAttribute("vUVDimensions",     SpriteShaderAttribID::UV_DIMENSIONS);
-            shader->setAttribute("vColour",           SpriteShaderAttribID::COLOUR);
+            setShaderAttributes(shader);
 
             if (shader->link() != ShaderLinkResult::SUCCESS) return false;
         }
@@ -312,6 +678,33 @@ bool spg::SpriteBatcher::setShader(GLSLProgram* shader /*= nullptr*/) {
 }
 
 void spg::SpriteBatcher::render(const f32m4& worldProjection, const f32m4& viewProjection) {
+        SP_PROFILE_ZONE("SpriteBatcher::render");
+
+        // A render device takes the built vertices and batches as they are, and does the rest itself.
+        if (m_device != nullptr) {
+            m_device->render(RenderFrame{
+                worldProjection,
+                viewProjection,
+                reinterpret_cast<const SpriteVertex*>(m_deviceVertices.data()),
+                m_batches.data(),
+                m_batches.size(),
+                &m_clipStack
+            });
+            return;
+        }
+
+#if defined(SP_PROFILING)
+        // Record the GPU times of earlier renders the GPU has finished, then time this one.
+        m_gpuTimer.collect();
+        m_gpuTimer.begin("SpriteBatcher::render");
+#endif
+
+        // Bring any layers that have changed up to date on the GPU. We do this before binding
+        // any vertex array, as updating them may touch our index buffer.
+        for (auto& layer : m_layers) {
+            if (layer->isDirty()) m_stats.vertexBytesUploaded += layer->upload();
+        }
+
         // Activate the shader.
         m_activeShader->use();
 
@@ -319,21 +712,76 @@ void spg::SpriteBatcher::render(const f32m4& worldProjection, const f32m4& viewP
         glUniformMatrix4fv(m_activeShader->getUniformLocation("WorldProjection"), 1, false, &worldProjection[0][0]);
         glUniformMatrix4fv(m_activeShader->getUniformLocation("ViewProjection"),  1, false, &viewProjection[0][0]);
 
-        // Bind our vertex array.
-        glBindVertexArray(m_vao);
-
         // Activate the zeroth texture slot in OpenGL, and pass the index to the texture uniform in our shader.
+        //     Texture arrays are bound to the first slot instead, as a slot may only be sampled as one type of texture.
         glActiveTexture(GL_TEXTURE0);
         glUniform1i(m_activeShader->getUniformLocation("SpriteTexture"), 0);
+        if (m_textureMode == SpriteTextureMode::ARRAY) {
+            glUniform1i(m_activeShader->getUniformLocation("SpriteTextureArray"), 1);
+        } else if (m_textureMode == SpriteTextureMode::MULTI_UNIT) {
+            // Each slot of the sampler array reads from the texture slot of the same index.
+            GLint units[MAX_BATCH_TEXTURES];
+            for (ui32 t = 0; t < MAX_BATCH_TEXTURES; ++t) {
+                units[t] = static_cast<GLint>(t);
+            }
+            glUniform1iv(m_activeShader->getUniformLocation("SpriteTextures"), static_cast<GLsizei>(m_maxBatchTextures), units);
+        }
 
-        // For each batch, bind its texture, set the sampler state (have to do this each time), and draw the triangles in that batch.
-        for (auto& batch : m_batches) {
-            glBindTexture(GL_TEXTURE_2D, batch.texture);
+        // Clip rectangles are in the coordinates sprites are drawn in, so to find where they
+        // lie on screen we need the full transform the shader applies, as well as the viewport.
+        m_clipTransform = viewProjection * worldProjection;
+        glGetIntegerv(GL_VIEWPORT, &m_viewport[0]);
+
+        GLuint vbo = m_uploadMode == SpriteUploadMode::STREAMING ? m_streamingBuffer.getID() : m_vbo;
+
+        // Opaque sprites are drawn first, with blending disabled, so that the depth they write lets the GPU reject
+        // the fragments of anything behind them before shading. Translucent sprites are then blended over them.
+        //     Only sprites sorted with OPAQUE_THEN_TRANSLUCENT are ever batched as opaque, and their opaque
+        //     batches come first - so other batches are drawn exactly as they would be otherwise.
+        auto hasOpaque = [](const Batches& batches) {
+            return !batches.empty() && batches.front().opaque;
+        };
+
+        bool blending = glIsEnabled(GL_BLEND) == GL_TRUE;
+        bool opaquePass = hasOpaque(m_batches);
+        for (auto& layer : m_layers) {
+            opaquePass |= hasOpaque(layer->m_batches);
+        }
+
+        if (opaquePass) {
+            glDisable(GL_BLEND);
+
+            for (auto& layer : m_layers) {
+                if (!hasOpaque(layer->m_batches)) continue;
+
+                glBindVertexArray(layer->m_vao);
+                renderBatches(layer->m_batches, layer->m_clipStack, layer->m_vbo, 0, true);
+            }
+
+            if (hasOpaque(m_batches)) {
+                glBindVertexArray(m_vao);
+                renderBatches(m_batches, m_clipStack, vbo, m_bufferOffset, true);
+            }
 
-            // Note that we pass an offset as the final argument despite glDrawElements expecting a pointer as we have already uploaded
-            // the data to the buffer on the GPU - we only need to pass an offset in bytes from the beginning of this buffer rather than
-            // the address of a buffer in RAM.
-            glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid*>(batch.indexOffset * sizeof(ui32)));
+            if (blending) glEnable(GL_BLEND);
+        }
+
+        // Draw each layer first, from its own vertex array and buffer.
+        for (auto& layer : m_layers) {
+            glBindVertexArray(layer->m_vao);
+
+            renderBatches(layer->m_batches, layer->m_clipStack, layer->m_vbo, 0, false);
+        }
+
+        // Bind our vertex array.
+        glBindVertexArray(m_vao);
+
+        // Draw the sprites of this batching phase.
+        renderBatches(m_batches, m_clipStack, vbo, m_bufferOffset, false);
+
+        // Guard the section of the ring we just drew from, so we don't overwrite it while the GPU is still reading.
+        if (m_uploadMode == SpriteUploadMode::STREAMING) {
+            m_streamingBuffer.fence();
         }
 
         // Unbind out vertex array.
@@ -341,6 +789,12 @@ void spg::SpriteBatcher::render(const f32m4& worldProjection, const f32m4& viewP
 
         // Deactivate our shader.
         m_activeShader->unuse();
+
+        countIndexUploads();
+
+#if defined(SP_PROFILING)
+        m_gpuTimer.end();
+#endif
 }
 
 void spg::SpriteBatcher::render(const f32m4& worldProjection, const f32v2& screenSize) {
@@ -360,121 +814,587 @@ void spg::SpriteBatcher::render(const f32v2& screenSize) {
     render(identity, screenSize);
 }
 
-void spg::SpriteBatcher::sortSprites(SpriteSortMode sortMode) {
-    if (m_spritePtrs.empty()) return;
+void spg::SpriteBatcher::setCullRect(const f32m4& worldProjection, const f32v2& screenSize) {
+    // The screen covers (0, 0) to screenSize in "camera" coords, so taking its corners back
+    // through the world projection gives us the area of the world that is visible.
+    f32m4 cameraToWorld = glm::inverse(worldProjection);
+
+    f32v2 corners[4] = {
+        f32v2(0.0f,         0.0f),
+        f32v2(screenSize.x, 0.0f),
+        f32v2(0.0f,         screenSize.y),
+        f32v2(screenSize.x, screenSize.y)
+    };
+
+    f32v2 minimum(std::numeric_limits<f32>::max());
+    f32v2 maximum(std::numeric_limits<f32>::lowest());
+    for (auto& corner : corners) {
+        f32v4 world = cameraToWorld * f32v4(corner.x, corner.y, 0.0f, 1.0f);
+
+        minimum.x = std::min(minimum.x, world.x);
+        minimum.y = std::min(minimum.y, world.y);
+        maximum.x = std::max(maximum.x, world.x);
+        maximum.y = std::max(maximum.y, world.y);
+    }
+
+    setCullRect(f32v4(minimum.x, minimum.y, maximum.x - minimum.x, maximum.y - minimum.y));
+}
 
-    // Sort the data according to mode.
+void spg::SpriteBatcher::addLayer(SpriteLayer* layer) {
+    if (std::find(m_layers.begin(), m_layers.end(), layer) != m_layers.end()) return;
+
+    m_layers.emplace_back(layer);
+}
+
+void spg::SpriteBatcher::removeLayer(SpriteLayer* layer) {
+    auto it = std::find(m_layers.begin(), m_layers.end(), layer);
+    if (it != m_layers.end()) m_layers.erase(it);
+}
+
+void spg::SpriteBatcher::bindBatchTexture(const SpriteBatch& batch) {
+    if (batch.textureTarget == GL_TEXTURE_2D_ARRAY) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, batch.textures[0]);
+        glActiveTexture(GL_TEXTURE0);
+
+        m_stats.textureBinds += 1;
+    } else if (batch.textureCount > 1) {
+        // Bind each texture to the slot its sprites were given.
+        for (ui32 t = 0; t < batch.textureCount; ++t) {
+            glActiveTexture(GL_TEXTURE0 + t);
+            glBindTexture(GL_TEXTURE_2D, batch.textures[t]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        m_stats.textureBinds += batch.textureCount;
+    } else {
+        glBindTexture(GL_TEXTURE_2D, batch.textures[0]);
+
+        m_stats.textureBinds += 1;
+    }
+}
+
+void spg::SpriteBatcher::applyClipRect(const ClipStack& clipStack, ui32 clipIndex) {
+    if (clipIndex == NO_CLIP) {
+        glDisable(GL_SCISSOR_TEST);
+        return;
+    }
+
+    i32v4 scissor = projectClipRect(clipStack.getRect(clipIndex), m_clipTransform, m_viewport);
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(scissor.x, scissor.y, scissor.z, scissor.w);
+}
+
+void spg::SpriteBatcher::renderBatches(const Batches& batches, const ClipStack& clipStack, GLuint vbo, size_t bufferOffset, bool opaque) {
+    // Batches are sorted by clip rectangle where possible, so we only touch the scissor state when it changes.
+    //     We assume the scissor test is disabled to begin with, and disable it again once done.
+    ui32 clipIndex = NO_CLIP;
+
+    // For each batch, bind its texture, set the sampler state (have to do this each time), and draw the triangles in that batch.
+    if (m_renderMode == SpriteRenderMode::INSTANCED) {
+        // Without base instance draws (GL 4.2+), we instead point our instance attributes at the
+        // first instance of each batch, so bind the buffer we need to point into.
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+        for (auto& batch : batches) {
+            if (batch.opaque != opaque) continue;
+
+            if (batch.clipIndex != clipIndex) {
+                clipIndex = batch.clipIndex;
+                applyClipRect(clipStack, clipIndex);
+            }
+
+            bindBatchTexture(batch);
+
+            setVertexAttribPointers(bufferOffset + batch.spriteOffset * sizeof(SpriteInstance));
+
+            // Draw a four-vertex triangle strip per instance - the vertex shader works out which corner
+            // of the quad each vertex is from its ID.
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, VERTICES_PER_QUAD, batch.spriteCount);
+
+            m_stats.drawCalls += 1;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    } else {
+        // The base vertex is non-zero only when streaming, where it points at the section of the ring holding this frame's vertices.
+        GLint baseVertex = static_cast<GLint>(bufferOffset / (getSpriteBytes() / VERTICES_PER_QUAD));
+
+        for (auto& batch : batches) {
+            if (batch.opaque != opaque) continue;
+
+            if (batch.clipIndex != clipIndex) {
+                clipIndex = batch.clipIndex;
+                applyClipRect(clipStack, clipIndex);
+            }
+
+            bindBatchTexture(batch);
+
+            // Every quad shares the same index pattern, so rather than offsetting into the indices we offset the
+            // vertices each index refers to - letting the shared index buffer use 16-bit indices for most batches.
+            m_stats.drawCalls += QuadIndexBuffer::draw(batch.spriteCount, baseVertex + static_cast<GLint>(batch.spriteOffset * VERTICES_PER_QUAD));
+        }
+    }
+
+    if (clipIndex != NO_CLIP) applyClipRect(clipStack, NO_CLIP);
+}
+
+void spg::SpriteBatcher::countIndexUploads() {
+    ui64 bytes       = QuadIndexBuffer::getBytesUploaded();
+    ui32 generations = QuadIndexBuffer::getGenerationCount();
+
+    m_stats.indexBytesUploaded  += bytes - m_indexBytesCounted;
+    m_stats.bufferReallocations += generations - m_indexGenerationsCounted;
+
+    m_indexBytesCounted       = bytes;
+    m_indexGenerationsCounted = generations;
+}
+
+void spg::SpriteBatcher::setShaderAttributes(GLSLProgram* shader) {
+    if (m_renderMode == SpriteRenderMode::INSTANCED) {
+        shader->setAttribute("vPosition",     SpriteInstanceShaderAttribID::INSTANCE_POSITION);
+        shader->setAttribute("vSize",         SpriteInstanceShaderAttribID::INSTANCE_SIZE);
+        shader->setAttribute("vDepth",        SpriteInstanceShaderAttribID::INSTANCE_DEPTH);
+        shader->setAttribute("vUVDimensions", SpriteInstanceShaderAttribID::INSTANCE_UV_DIMENSIONS);
+        shader->setAttribute("vColour1",      SpriteInstanceShaderAttribID::INSTANCE_COLOUR_1);
+        shader->setAttribute("vColour2",      SpriteInstanceShaderAttribID::INSTANCE_COLOUR_2);
+        shader->setAttribute("vGradient",     SpriteInstanceShaderAttribID::INSTANCE_GRADIENT);
+        shader->setAttribute("vTextureIndex", SpriteInstanceShaderAttribID::INSTANCE_TEXTURE_INDEX);
+    } else if (m_vertexFormat == SpriteVertexFormat::COMPACT) {
+        shader->setAttribute("vPosition",      CompactSpriteShaderAttribID::COMPACT_POSITION);
+        shader->setAttribute("vTextureCoords", CompactSpriteShaderAttribID::COMPACT_TEXTURE_COORDS);
+        shader->setAttribute("vColour",        CompactSpriteShaderAttribID::COMPACT_COLOUR);
+        shader->setAttribute("vTextureIndex",  CompactSpriteShaderAttribID::COMPACT_TEXTURE_INDEX);
+    } else {
+        shader->setAttribute("vPosition",         SpriteShaderAttribID::POSITION);
+        shader->setAttribute("vRelativePosition", SpriteShaderAttribID::RELATIVE_POSITION);
+        shader->setAttribute("vUVDimensions",     SpriteShaderAttribID::UV_DIMENSIONS);
+        shader->setAttribute("vColour",           SpriteShaderAttribID::COLOUR);
+        shader->setAttribute("vTextureIndex",     SpriteShaderAttribID::TEXTURE_INDEX);
+    }
+}
+
+void spg::SpriteBatcher::setVertexAttribPointers(size_t offset) {
+    if (m_renderMode == SpriteRenderMode::INSTANCED) {
+        // As for vertices below, but each attribute is advanced once per instance rather than once per
+        // vertex (as set by the divisor). The gradient is passed as an integer, so uses the I variant.
+        glVertexAttribPointer(SpriteInstanceShaderAttribID::INSTANCE_POSITION,      2, GL_FLOAT,         false, sizeof(SpriteInstance), reinterpret_cast<void*>(offset + offsetof(SpriteInstance, position)));
+        glVertexAttribPointer(SpriteInstanceShaderAttribID::INSTANCE_SIZE,          2, GL_FLOAT,         false, sizeof(SpriteInstance), reinterpret_cast<void*>(offset + offsetof(SpriteInstance, size)));
+        glVertexAttribPointer(SpriteInstanceShaderAttribID::INSTANCE_DEPTH,         1, GL_FLOAT,         false, sizeof(SpriteInstance), reinterpret_cast<void*>(offset + offsetof(SpriteInstance, depth)));
+        glVertexAttribPointer(SpriteInstanceShaderAttribID::INSTANCE_UV_DIMENSIONS, 4, GL_FLOAT,         false, sizeof(SpriteInstance), reinterpret_cast<void*>(offset + offsetof(SpriteInstance, uvDimensions)));
+        glVertexAttribPointer(SpriteInstanceShaderAttribID::INSTANCE_COLOUR_1,      4, GL_UNSIGNED_BYTE, true,  sizeof(SpriteInstance), reinterpret_cast<void*>(offset + offsetof(SpriteInstance, c1)));
+        glVertexAttribPointer(SpriteInstanceShaderAttribID::INSTANCE_COLOUR_2,      4, GL_UNSIGNED_BYTE, true,  sizeof(SpriteInstance), reinterpret_cast<void*>(offset + offsetof(SpriteInstance, c2)));
+        glVertexAttribIPointer(SpriteInstanceShaderAttribID::INSTANCE_GRADIENT,     1, GL_UNSIGNED_INT,         sizeof(SpriteInstance), reinterpret_cast<void*>(offset + offsetof(SpriteInstance, gradient)));
+        glVertexAttribIPointer(SpriteInstanceShaderAttribID::INSTANCE_TEXTURE_INDEX, 1, GL_INT,                 sizeof(SpriteInstance), reinterpret_cast<void*>(offset + offsetof(SpriteInstance, textureIndex)));
+
+        for (GLuint attrib = 0; attrib < SpriteInstanceShaderAttribID_SENTINEL; ++attrib) {
+            glVertexAttribDivisor(attrib, 1);
+        }
+
+        return;
+    }
+
+    if (m_vertexFormat == SpriteVertexFormat::COMPACT) {
+        // As for vertices below, but the texture coordinates are normalised from 16-bit integers.
+        glVertexAttribPointer(CompactSpriteShaderAttribID::COMPACT_POSITION,        3, GL_FLOAT,          false, sizeof(CompactSpriteVertex), reinterpret_cast<void*>(offset + offsetof(CompactSpriteVertex, position)));
+        glVertexAttribPointer(CompactSpriteShaderAttribID::COMPACT_TEXTURE_COORDS,  2, GL_UNSIGNED_SHORT, true,  sizeof(CompactSpriteVertex), reinterpret_cast<void*>(offset + offsetof(CompactSpriteVertex, textureCoords)));
+        glVertexAttribPointer(CompactSpriteShaderAttribID::COMPACT_COLOUR,          4, GL_UNSIGNED_BYTE,  true,  sizeof(CompactSpriteVertex), reinterpret_cast<void*>(offset + offsetof(CompactSpriteVertex, colour)));
+        glVertexAttribIPointer(CompactSpriteShaderAttribID::COMPACT_TEXTURE_INDEX,  1, GL_SHORT,                 sizeof(CompactSpriteVertex), reinterpret_cast<void*>(offset + offsetof(CompactSpriteVertex, textureIndex)));
+
+        return;
+    }
+
+    // Connect the vertex attributes in the shader (e.g. vPosition) to its corresponding chunk of memory inside the SpriteVertex struct.
+    //     We first tell OpenGL the ID of the attribute within the shader (as we set earlier), then the number of values and their type.
+    //
+    //     After that, we tell OpenGL whether that data should be normalised (e.g. unsigned bytes that need normalising will be converted 
+    //     to a float divided through by 255.0f and by OpenGL - so that colours, e.g., are represented by values between 0.0f and 1.0f 
+    //     per R/G/B/A channel rather than the usual 0 to 255).
+    //
+    //     We then pass the size of the data representing a vertex followed by how many bytes into that data the value is stored - we use offset rather than 
+    //     manually writing this to give us flexibility in changing the order of the SpriteVertex struct.
+    //
+    //     Note that these pointers are stored in the vertex array along with the buffer bound at the time of the call.
+    glVertexAttribPointer(SpriteShaderAttribID::POSITION,          3, GL_FLOAT,         false, sizeof(SpriteVertex), reinterpret_cast<void*>(offset + offsetof(SpriteVertex, position)));
+    glVertexAttribPointer(SpriteShaderAttribID::RELATIVE_POSITION, 2, GL_FLOAT,         false, sizeof(SpriteVertex), reinterpret_cast<void*>(offset + offsetof(SpriteVertex, relativePosition)));
+    glVertexAttribPointer(SpriteShaderAttribID::UV_DIMENSIONS,     4, GL_FLOAT,         false, sizeof(SpriteVertex), reinterpret_cast<void*>(offset + offsetof(SpriteVertex, uvDimensions)));
+    glVertexAttribPointer(SpriteShaderAttribID::COLOUR,            4, GL_UNSIGNED_BYTE, true,  sizeof(SpriteVertex), reinterpret_cast<void*>(offset + offsetof(SpriteVertex, colour)));
+    glVertexAttribIPointer(SpriteShaderAttribID::TEXTURE_INDEX,    1, GL_INT,                  sizeof(SpriteVertex), reinterpret_cast<void*>(offset + offsetof(SpriteVertex, textureIndex)));
+}
+
+void spg::SpriteBatcher::cullSprites(Sprites& sprites) {
+    const f32 left   = m_cullRect.x;
+    const f32 top    = m_cullRect.y;
+    const f32 right  = m_cullRect.x + m_cullRect.z;
+    const f32 bottom = m_cullRect.y + m_cullRect.w;
+
+    size_t count = sprites.size();
+    m_cullIndices.resize(count);
+
+    // Test each sprite's bounds against the cull rectangle, always writing its index but only
+    // moving on to the next index if it is visible. Most sprites of a large world are culled,
+    // so this avoids a hard to predict branch for every sprite.
+    //     Sizes may be negative (e.g. for flipped sprites), so we take the min & max of each
+    //     sprite's edges rather than assuming the position is its top left.
+    ui32* indices = m_cullIndices.data();
+    size_t kept   = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Sprite& sprite = sprites[i];
+
+        f32 x0 = sprite.position.x, x1 = sprite.position.x + sprite.size.x;
+        f32 y0 = sprite.position.y, y1 = sprite.position.y + sprite.size.y;
+
+        bool visible = (std::max(x0, x1) > left) & (std::min(x0, x1) < right)
+                            & (std::max(y0, y1) > top) & (std::min(y0, y1) < bottom);
+
+        indices[kept] = static_cast<ui32>(i);
+        kept         += visible;
+    }
+
+    if (kept == count) return;
+
+    // Move the visible sprites down over the culled ones. Each visible sprite's index is at
+    // least its new position, so we never overwrite a sprite we have yet to move.
+    for (size_t i = 0; i < kept; ++i) {
+        sprites[i] = sprites[indices[i]];
+    }
+    sprites.resize(kept);
+}
+
+void spg::SpriteBatcher::sortSprites(SpriteSortMode sortMode, Sprites& sprites, SpritePtrs& spritePtrs) {
+    SP_PROFILE_ZONE("SpriteBatcher::sortSprites");
+
+    // Make sure we have the right amount of space to then assign a pointer for each sprite.
+    if (spritePtrs.size() != sprites.size()) {
+        spritePtrs.resize(sprites.size());
+    }
+
+    if (sprites.empty()) return;
+
+    size_t count = sprites.size();
+
+    m_sortKeys.resize(count);
+    m_sortKeysScratch.resize(count);
+    m_sortIndices.resize(count);
+    m_sortIndicesScratch.resize(count);
+
+    // Build the keys according to mode. We walk the sprites in order here, so this is the
+    // only time we touch the sprites themselves until generating batches.
+    //     Depths are converted to integers of the same ordering; for back to front we
+    //     flip those bits so that greater depths come first.
+    //     Sorting by texture sorts by the texture we batch by, so that sprites whose textures
+    //     share a texture array are kept together.
+    i32 layer;
     switch (sortMode) {
     case SpriteSortMode::TEXTURE:
-        std::stable_sort(m_spritePtrs.begin(), m_spritePtrs.end(), &sortTexture);
+        for (size_t i = 0; i < count; ++i) {
+            m_sortKeys[i] = (static_cast<ui64>(sprites[i].clipIndex) << 32)
+                                | static_cast<ui64>(getBatchTexture(sprites[i].texture, layer));
+        }
         break;
     case SpriteSortMode::FRONT_TO_BACK:
-        std::stable_sort(m_spritePtrs.begin(), m_spritePtrs.end(), &sortFrontToBack);
+        for (size_t i = 0; i < count; ++i) {
+            m_sortKeys[i] = static_cast<ui64>(floatToOrderedBits(sprites[i].depth));
+        }
         break;
     case SpriteSortMode::BACK_TO_FRONT:
-        std::stable_sort(m_spritePtrs.begin(), m_spritePtrs.end(), &sortBackToFront);
+        for (size_t i = 0; i < count; ++i) {
+            m_sortKeys[i] = static_cast<ui64>(~floatToOrderedBits(sprites[i].depth));
+        }
+        break;
+    case SpriteSortMode::OPAQUE_THEN_TRANSLUCENT:
+        // Opaque sprites come first, front to back, and then translucent sprites, back to front. Within
+        // the same depth, sprites are kept together by texture.
+        for (size_t i = 0; i < count; ++i) {
+            ui64 texture = static_cast<ui64>(getBatchTexture(sprites[i].texture, layer)) & 0x7FFFFFFF;
+            ui32 depth   = floatToOrderedBits(sprites[i].depth);
+
+            if (isOpaque(sprites[i])) {
+                m_sortKeys[i] = (static_cast<ui64>(depth) << 31) | texture;
+            } else {
+                m_sortKeys[i] = (1ull << 63) | (static_cast<ui64>(~depth) << 31) | texture;
+            }
+        }
+        break;
+    case SpriteSortMode::TEXTURE_THEN_DEPTH:
+        for (size_t i = 0; i < count; ++i) {
+            m_sortKeys[i] = (static_cast<ui64>(getBatchTexture(sprites[i].texture, layer)) << 32)
+                                | static_cast<ui64>(floatToOrderedBits(sprites[i].depth));
+        }
         break;
     default:
+        // Unknown sort modes leave the sprites in the order they were drawn.
+        std::fill(m_sortKeys.begin(), m_sortKeys.end(), 0);
         break;
     }
+
+    for (size_t i = 0; i < count; ++i) {
+        m_sortIndices[i] = static_cast<ui32>(i);
+    }
+
+    // Sort the keys, bringing the indices of their sprites along with them.
+    radixSort(m_sortKeys.data(), m_sortIndices.data(), m_sortKeysScratch.data(), m_sortIndicesScratch.data(), count);
+
+    // Point at the sprites in their sorted order.
+    for (size_t i = 0; i < count; ++i) {
+        spritePtrs[i] = &sprites[m_sortIndices[i]];
+    }
 }
 
 void spg::SpriteBatcher::generateBatches() {
+    SP_PROFILE_ZONE("SpriteBatcher::generateBatches");
+
+    // With a render device, sprites are just built into a CPU-side buffer that the device reads from when rendering.
+    if (m_device != nullptr) {
+        m_deviceVertices.resize(getSpriteBytes() * m_spritePtrs.size());
+
+        ui64 buildStart = clockNanoseconds();
+
+        computeBatches(m_sortMode, m_spritePtrs, m_batches, m_textureIndices);
+        buildAllSprites(m_spritePtrs, m_textureIndices, m_deviceVertices.data());
+
+        m_stats.buildTime = clockNanoseconds() - buildStart;
+        return;
+    }
+
     // If we have no sprites, just tell the GPU we have nothing.
     if (m_spritePtrs.empty()) {
-        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, m_usageHint);
+        if (m_uploadMode != SpriteUploadMode::STREAMING) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+            glBufferData(GL_ARRAY_BUFFER, 0, nullptr, m_usageHint);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            if (m_vboSize != 0) m_stats.bufferReallocations += 1;
+            m_vboSize = 0;
+        }
         return;
     }
 
-    // Create a buffer of vertices to be populated and sent to the GPU.
-    SpriteVertex* vertices = new SpriteVertex[VERTICES_PER_QUAD * m_spritePtrs.size()];
+    // Determine how much data we send to the GPU per sprite - either a whole quad's worth of
+    // vertices or a single instance.
+    const size_t dataSize = getSpriteBytes() * m_spritePtrs.size();
 
-    // Some counts to help us know where we're at with populating the vertices.
-    ui32 vertCount  = 0;
-    ui32 indexCount = 0;
+    // Get a buffer to be populated and sent to the GPU.
+    //     When streaming, this is the next section of our ring of GPU memory, otherwise we
+    //     build into a CPU-side buffer and copy it over afterwards.
+    //     Mapping may wait on the GPU to finish with the section, so we count it as upload time.
+    ui8* data;
+    if (m_uploadMode == SpriteUploadMode::STREAMING) {
+        ui64 mapStart = clockNanoseconds();
 
-    // Create our first batch, which has 0 offset and texture the same as that of
-    // the first sprite - as it defines the first batch.
-    m_batches.emplace_back();
-    m_batches.back().indexOffset = 0;
-    m_batches.back().texture     = m_spritePtrs[0]->texture;
+        bool recreated;
+        data = static_cast<ui8*>(m_streamingBuffer.map(dataSize, recreated));
 
-    // For each sprite, we want to populate the vertex buffer with those for that
-    // sprite. In the case that we are changing to a new texture, we need to 
-    // start a new batch.
-    for (auto& sprite : m_spritePtrs) {
-        // Start a new batch with texture of the sprite we're currently working with
-        // if that texture is different to the previous batch.
-        if (sprite->texture != m_batches.back().texture) {
-            // Now we are making a new batch, we can set the number of indices in 
-            // the previous batch.
-            m_batches.back().indexCount = indexCount - m_batches.back().indexOffset;
-            m_batches.emplace_back();
+        m_stats.uploadTime = clockNanoseconds() - mapStart;
 
-            m_batches.back().indexOffset = indexCount;
-            m_batches.back().texture     = sprite->texture;
-        }
+        // If we failed to get any memory to write to, draw nothing.
+        if (data == nullptr) return;
+
+        // A new buffer needs our vertex attributes pointing at it.
+        if (recreated) {
+            m_stats.bufferReallocations += 1;
+
+            glBindVertexArray(m_vao);
+            glBindBuffer(GL_ARRAY_BUFFER, m_streamingBuffer.getID());
+
+            setVertexAttribPointers(0);
 
-        // Builds the sprite's quad, i.e. adds the sprite's vertices to the vertex buffer.
-        sprite->build(sprite, vertices + vertCount);
-
-        // Update our counts.
-        vertCount  += VERTICES_PER_QUAD;
-        indexCount += INDICES_PER_QUAD;
-    }
-    m_batches.back().indexCount = indexCount - m_batches.back().indexOffset;
-
-    // If we need more indices than we have so far uploaded to the GPU, we must
-    // generate more and update the index buffer on the GPU.
-    //     For now the index pattern is the same for all sprites, as all sprites are
-    //     treated as quads. If we want to support other geometries of sprite we will
-    //     have to change this.
-    if (m_indexCount < indexCount) {
-        m_indexCount = indexCount;
-
-        // Bind the index buffer.
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-        // Invalidate the old buffer data on the GPU so that when we write our new data we don't
-        // need to wait for the old data to be unused by the GPU.
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexCount * sizeof(ui32), nullptr, m_usageHint);
-
-        // Create a local index buffer we will upload to the GPU.
-        ui32* indices = new ui32[m_indexCount];
-        ui32 i = 0; // Index cursor.
-        ui32 v = 0; // Vertex cursor.
-        while (i < m_indexCount) {
-            // For each quad, we have four vertices which we write 6 indices for - giving us two triangles.
-            // The order of these indices is important - each triple should form a triangle correlating
-            // to the build functions.
-            indices[i++] = v;     // Top left vertex.
-            indices[i++] = v + 2; // Bottom left vertex.
-            indices[i++] = v + 3; // Bottom right vertex.
-            indices[i++] = v + 3; // Bottom right vertex.
-            indices[i++] = v + 1; // Top right vertex.
-            indices[i++] = v;     // Top left vertex.
-
-            v += 4;
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
 
-        // Send the indices over to the GPU.
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m_indexCount * sizeof(ui32), indices);
-        // Unbind our buffer object.
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        m_bufferOffset = m_streamingBuffer.getCurrentOffset();
+    } else {
+        data = new ui8[dataSize];
+    }
+
+    // Work out where each batch begins and ends, then build the sprites into the buffer.
+    ui64 buildStart = clockNanoseconds();
+
+    computeBatches(m_sortMode, m_spritePtrs, m_batches, m_textureIndices);
+    buildAllSprites(m_spritePtrs, m_textureIndices, data);
+
+    ui64 uploadStart = clockNanoseconds();
+    m_stats.buildTime = uploadStart - buildStart;
+
+    m_stats.vertexBytesUploaded += dataSize;
+
+    // When streaming, the data is already where the GPU can see it.
+    if (m_uploadMode == SpriteUploadMode::STREAMING) {
+        m_streamingBuffer.unmap();
+
+        m_stats.uploadTime += clockNanoseconds() - uploadStart;
+        return;
     }
 
     // Bind the vertex buffer and delete the old data from the GPU.
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
     // Invalidate the old buffer data on the GPU so that when we write our new data we don't
     // need to wait for the old data to be unused by the GPU.
-    glBufferData(GL_ARRAY_BUFFER, vertCount * sizeof(SpriteVertex), nullptr, m_usageHint);
+    glBufferData(GL_ARRAY_BUFFER, dataSize, nullptr, m_usageHint);
     // Write our new data.
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertCount * sizeof(SpriteVertex), vertices);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, dataSize, data);
     // Unbind our buffer object.
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+    m_stats.uploadTime = clockNanoseconds() - uploadStart;
+
+    if (dataSize != m_vboSize) m_stats.bufferReallocations += 1;
+    m_vboSize = dataSize;
+
     // Clear up memory.
-    delete[] vertices;
+    delete[] data;
+}
+
+void spg::SpriteBatcher::computeBatches(SpriteSortMode sortMode, const SpritePtrs& spritePtrs, Batches& batches, TextureIndices& textureIndices) {
+    batches.clear();
+    textureIndices.resize(spritePtrs.size());
+
+    if (spritePtrs.empty()) return;
+
+    ui32 spriteCount = static_cast<ui32>(spritePtrs.size());
+
+    // Only in multi-unit texture mode may a batch hold more than one texture.
+    const bool multiUnit   = m_textureMode == SpriteTextureMode::MULTI_UNIT;
+    const ui32 maxTextures = multiUnit ? m_maxBatchTextures : 1;
+
+    // Only when sorted to draw opaque sprites first do we batch them apart from translucent sprites.
+    const bool splitOpacity = sortMode == SpriteSortMode::OPAQUE_THEN_TRANSLUCENT;
+
+    // Work out where each batch begins and ends before building any sprites. This pass
+    // only looks at textures so is cheap, and doing it up front means the sprites can
+    // then be built in any order - and so in parallel.
+    for (ui32 i = 0; i < spriteCount; ++i) {
+        i32    layer;
+        GLuint texture   = getBatchTexture(spritePtrs[i]->texture, layer);
+        ui32   clipIndex = spritePtrs[i]->clipIndex;
+        bool   opaque    = splitOpacity && isOpaque(*spritePtrs[i]);
+
+        // Find the slot of the sprite's texture in the current batch, giving it a new
+        // slot if the batch doesn't have it yet but has room for it. Sprites with a
+        // different clip rectangle or opacity can never join the current batch.
+        //     Consecutive sprites most often share a texture, so search from the last
+        //     texture added.
+        i32 slot = -1;
+        if (!batches.empty() && batches.back().clipIndex == clipIndex && batches.back().opaque == opaque) {
+            SpriteBatch& batch = batches.back();
+            for (ui32 t = batch.textureCount; t-- > 0;) {
+                if (batch.textures[t] == texture) {
+                    slot = static_cast<i32>(t);
+                    break;
+                }
+            }
+
+            if (slot < 0 && batch.textureCount < maxTextures) {
+                slot = static_cast<i32>(batch.textureCount);
+                batch.textures[batch.textureCount++] = texture;
+            }
+        }
+
+        // Start a new batch with texture of the sprite we're currently working with
+        // if the previous batch cannot take that texture.
+        if (slot < 0) {
+            // Now we are making a new batch, we can set the number of sprites in 
+            // the previous batch.
+            if (!batches.empty()) {
+                batches.back().spriteCount = i - batches.back().spriteOffset;
+            }
+            batches.emplace_back();
+
+            SpriteBatch& batch  = batches.back();
+            batch.textureTarget = layer < 0 ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+            batch.textures[0]   = texture;
+            batch.textureCount  = 1;
+            batch.spriteOffset  = i;
+            batch.clipIndex     = clipIndex;
+            batch.opaque        = opaque;
+
+            slot = 0;
+        }
+
+        // Shaders find the texture of the sprite by its slot in multi-unit mode, or its
+        // layer in the batch's texture array otherwise.
+        textureIndices[i] = multiUnit ? slot : layer;
+    }
+    batches.back().spriteCount = spriteCount - batches.back().spriteOffset;
+}
+
+void spg::SpriteBatcher::buildAllSprites(const SpritePtrs& spritePtrs, const TextureIndices& textureIndices, ui8* data) {
+    size_t spriteCount = spritePtrs.size();
+    size_t spriteBytes = getSpriteBytes();
+
+    // Build each sprite into the buffer. With a worker pool and enough sprites to make it
+    // worthwhile, chunks of sprites are built on each worker - every sprite has its own
+    // slot in the buffer so the workers never write to the same memory.
+    if (m_workerPool != nullptr && spriteCount >= PARALLEL_BUILD_THRESHOLD) {
+        m_workerPool->parallelFor(spriteCount, PARALLEL_BUILD_CHUNK_SIZE, [&](size_t begin, size_t end) {
+            buildSprites(spritePtrs.data() + begin, textureIndices.data() + begin, data + begin * spriteBytes, end - begin);
+        });
+    } else {
+        buildSprites(spritePtrs.data(), textureIndices.data(), data, spriteCount);
+    }
+}
+
+void spg::SpriteBatcher::buildSprites(Sprite* const* sprites, const i32* textureIndices, ui8* data, size_t count) {
+    // Builds each sprite's quad, i.e. adds the sprite's vertices to the vertex buffer, or
+    // its instance when instancing.
+    if (m_renderMode == SpriteRenderMode::INSTANCED) {
+        SpriteInstance* instances = reinterpret_cast<SpriteInstance*>(data);
+        for (size_t i = 0; i < count; ++i) {
+            buildInstance(sprites[i], instances + i);
+        }
+    } else if (m_vertexFormat == SpriteVertexFormat::COMPACT) {
+        // Build each quad as usual, so that custom builders still work, then pack it down.
+        CompactSpriteVertex* vertices = reinterpret_cast<CompactSpriteVertex*>(data);
+        SpriteVertex         quad[VERTICES_PER_QUAD];
+        for (size_t i = 0; i < count; ++i) {
+            const Sprite* sprite = sprites[i];
+            sprite->build(sprite, quad);
+
+            compactQuad(quad, vertices + i * VERTICES_PER_QUAD);
+        }
+    } else {
+        SpriteVertex* vertices = reinterpret_cast<SpriteVertex*>(data);
+        for (size_t i = 0; i < count; ++i) {
+            const Sprite* sprite = sprites[i];
+            sprite->build(sprite, vertices + i * VERTICES_PER_QUAD);
+        }
+    }
+
+    if (m_textureMode == SpriteTextureMode::SINGLE) return;
+
+    // The builders know nothing of texture arrays or slots, so we fill in the index of
+    // each sprite's texture afterwards.
+    if (m_renderMode == SpriteRenderMode::INSTANCED) {
+        SpriteInstance* instances = reinterpret_cast<SpriteInstance*>(data);
+        for (size_t i = 0; i < count; ++i) {
+            instances[i].textureIndex = textureIndices[i];
+        }
+    } else if (m_vertexFormat == SpriteVertexFormat::COMPACT) {
+        CompactSpriteVertex* vertices = reinterpret_cast<CompactSpriteVertex*>(data);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t vertex = 0; vertex < VERTICES_PER_QUAD; ++vertex) {
+                vertices[i * VERTICES_PER_QUAD + vertex].textureIndex = static_cast<i16>(textureIndices[i]);
+            }
+        }
+    } else {
+        SpriteVertex* vertices = reinterpret_cast<SpriteVertex*>(data);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t vertex = 0; vertex < VERTICES_PER_QUAD; ++vertex) {
+                vertices[i * VERTICES_PER_QUAD + vertex].textureIndex = textureIndices[i];
+            }
+        }
+    }
+}
+
+size_t spg::SpriteBatcher::getSpriteBytes() const {
+    // Each sprite is either a single instance or a whole quad's worth of vertices.
+    if (m_renderMode == SpriteRenderMode::INSTANCED) return sizeof(SpriteInstance);
+
+    if (m_vertexFormat == SpriteVertexFormat::COMPACT) return VERTICES_PER_QUAD * sizeof(CompactSpriteVertex);
+
+    return VERTICES_PER_QUAD * sizeof(SpriteVertex);
 }
 
 void spg::buildQuad(const Sprite* sprite, SpriteVertex* vertices) {
@@ -506,6 +1426,9 @@ void spg::buildQuad(const Sprite* sprite, SpriteVertex* vertices) {
     bottomRight.relativePosition = f32v2(1.0f, 1.0f);
     bottomRight.uvDimensions     = sprite->uvDimensions;
 
+    // Sprites are drawn from a plain texture unless the sprite batcher says otherwise.
+    topLeft.textureIndex = topRight.textureIndex = bottomLeft.textureIndex = bottomRight.textureIndex = -1;
+
     switch (sprite->gradient) {
         case Gradient::LEFT_TO_RIGHT:
             topLeft.colour  = bottomLeft.colour  = sprite->c1;
@@ -533,3 +1456,33 @@ void spg::buildQuad(const Sprite* sprite, SpriteVertex* vertices) {
             assert(false);
     }
 }
+
+void spg::buildInstance(const Sprite* sprite, SpriteInstance* instance) {
+    instance->position     = sprite->position;
+    instance->size         = sprite->size;
+    instance->depth        = sprite->depth;
+    instance->uvDimensions = sprite->uvDimensions;
+    instance->c1           = sprite->c1;
+    instance->c2           = sprite->c2;
+    instance->gradient     = static_cast<ui32>(sprite->gradient);
+    instance->textureIndex = -1;
+}
+
+void spg::compactQuad(const SpriteVertex* vertices, CompactSpriteVertex* compactVertices) {
+    for (size_t i = 0; i < VERTICES_PER_QUAD; ++i) {
+        const SpriteVertex&  vertex        = vertices[i];
+        CompactSpriteVertex& compactVertex = compactVertices[i];
+
+        // Work out the vertex's texture coordinates as the fragment shader otherwise would,
+        // then quantise them - the interpolation across the quad gives the same results.
+        f32v2 textureCoords = vertex.relativePosition * f32v2(vertex.uvDimensions.z, vertex.uvDimensions.w)
+                                + f32v2(vertex.uvDimensions.x, vertex.uvDimensions.y);
+
+        compactVertex.position        = vertex.position;
+        compactVertex.textureCoords.x = static_cast<ui16>(glm::clamp(textureCoords.x, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        compactVertex.textureCoords.y = static_cast<ui16>(glm::clamp(textureCoords.y, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        compactVertex.colour          = vertex.colour;
+        compactVertex.textureIndex    = static_cast<i16>(vertex.textureIndex);
+        compactVertex.padding         = 0;
+    }
+}
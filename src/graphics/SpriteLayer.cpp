@@ -0,0 +1,217 @@
+#include "stdafx.h"
+#include "graphics/SpriteLayer.h"
+
+#include "graphics/QuadIndexBuffer.h"
+
+// Dirty ranges separated by no more than this many clean sprites are uploaded as one.
+#define DIRTY_RANGE_MERGE_GAP 8
+
+spg::SpriteLayer::SpriteLayer() :
+    m_batcher(nullptr),
+    m_vao(0), m_vbo(0),
+    m_dirty(false),
+    m_sortMode(SpriteSortMode::TEXTURE)
+{
+    /* Empty */
+}
+
+void spg::SpriteLayer::init(SpriteBatcher* batcher) {
+    m_batcher        = batcher;
+    m_defaultTexture = batcher->m_defaultTexture;
+
+    // Create a vertex array and buffer just as the sprite batcher does, along with our own
+    // hold on the shared quad index buffer so that it outlives the sprite batcher if need be.
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vbo);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, QuadIndexBuffer::acquire());
+
+    m_batcher->m_defaultShader.enableVertexAttribArrays();
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    m_batcher->setVertexAttribPointers(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER,         0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void spg::SpriteLayer::dispose() {
+    if (m_batcher != nullptr) {
+        m_batcher->removeLayer(this);
+        m_batcher = nullptr;
+    }
+
+    if (m_vbo != 0) {
+        glDeleteBuffers(1, &m_vbo);
+        m_vbo = 0;
+    }
+
+    if (m_vao != 0) {
+        glDeleteVertexArrays(1, &m_vao);
+        m_vao = 0;
+
+        QuadIndexBuffer::release();
+    }
+
+    m_dirty          = false;
+    m_sortMode       = SpriteSortMode::TEXTURE;
+    m_defaultTexture = 0;
+
+    std::vector<Sprite>().swap(m_sprites);
+    m_clipStack.dispose();
+    m_frameArena.dispose();
+    m_textLayout = TextLayout{};
+    std::vector<Sprite*>().swap(m_spritePtrs);
+    std::vector<SpriteBatch>().swap(m_batches);
+    std::vector<i32>().swap(m_textureIndices);
+
+    std::vector<ui32>().swap(m_slots);
+    std::vector<ui32>().swap(m_dirtySlots);
+
+    std::vector<ui8>().swap(m_rangeData);
+}
+
+void spg::SpriteLayer::begin() {
+    m_sprites.clear();
+    m_clipStack.clear();
+    // Strings drawn into the layer were laid out in its arena, but only the sprites made of them are kept.
+    m_frameArena.reset();
+    m_batches.clear();
+    m_slots.clear();
+    m_dirtySlots.clear();
+}
+
+void spg::SpriteLayer::end(SpriteSortMode sortMode /*= SpriteSortMode::TEXTURE*/) {
+    m_sortMode = sortMode;
+
+    // Sort and batch now, but leave building and uploading the sprites until we are next
+    // rendered - so rebuilding more than once between renders only uploads once.
+    sort();
+}
+
+void spg::SpriteLayer::update(SpriteHandle handle, const Sprite& sprite) {
+    Sprite& current = m_sprites[handle];
+
+    GLuint texture = sprite.texture == 0 ? m_defaultTexture : sprite.texture;
+
+    // Work out if the sprite would move in the sorted order. A change of texture always
+    // may, as it changes which batch the sprite belongs to, while a change of depth only
+    // may if we sort by depth.
+    bool moves = texture != current.texture;
+    if (current.depth != sprite.depth) {
+        moves |= m_sortMode == SpriteSortMode::FRONT_TO_BACK
+                    || m_sortMode == SpriteSortMode::BACK_TO_FRONT
+                    || m_sortMode == SpriteSortMode::TEXTURE_THEN_DEPTH
+                    || m_sortMode == SpriteSortMode::OPAQUE_THEN_TRANSLUCENT;
+    }
+
+    // The sprite keeps the clip rectangle it was drawn with - the indices of clip rectangles
+    // are only meaningful to the layer.
+    ui32 clipIndex = current.clipIndex;
+
+    // A change of opacity moves the sprite between the opaque and translucent batches.
+    bool wasOpaque = m_batcher->isOpaque(current);
+
+    current           = sprite;
+    current.texture   = texture;
+    current.clipIndex = clipIndex;
+
+    if (m_sortMode == SpriteSortMode::OPAQUE_THEN_TRANSLUCENT) {
+        moves |= wasOpaque != m_batcher->isOpaque(current);
+    }
+
+    if (moves) {
+        sort();
+    } else if (!m_dirty) {
+        m_dirtySlots.emplace_back(m_slots[handle]);
+    }
+}
+
+void spg::SpriteLayer::sort() {
+    m_batcher->sortSprites(m_sortMode, m_sprites, m_spritePtrs);
+    m_batcher->computeBatches(m_sortMode, m_spritePtrs, m_batches, m_textureIndices);
+
+    // Note where each sprite ended up, so that updates by handle know what to upload.
+    m_slots.resize(m_sprites.size());
+    for (size_t i = 0; i < m_spritePtrs.size(); ++i) {
+        m_slots[static_cast<size_t>(m_spritePtrs[i] - m_sprites.data())] = static_cast<ui32>(i);
+    }
+
+    m_dirty = true;
+    m_dirtySlots.clear();
+}
+
+size_t spg::SpriteLayer::upload() {
+    // If only some sprites have changed, upload just the ranges they fall in.
+    if (!m_dirty) {
+        std::sort(m_dirtySlots.begin(), m_dirtySlots.end());
+
+        size_t uploaded = 0;
+
+        ui32 begin = m_dirtySlots[0];
+        ui32 end   = begin + 1;
+        for (size_t i = 1; i < m_dirtySlots.size(); ++i) {
+            ui32 slot = m_dirtySlots[i];
+
+            // Extend the current range over small gaps, as one slightly larger upload is
+            // cheaper than many small ones.
+            if (slot <= end + DIRTY_RANGE_MERGE_GAP) {
+                end = std::max(end, slot + 1);
+                continue;
+            }
+
+            uploaded += uploadRange(begin, end);
+
+            begin = slot;
+            end   = slot + 1;
+        }
+        uploaded += uploadRange(begin, end);
+
+        m_dirtySlots.clear();
+        return uploaded;
+    }
+
+    m_dirty = false;
+    m_dirtySlots.clear();
+
+    const size_t dataSize = m_batcher->getSpriteBytes() * m_spritePtrs.size();
+
+    // As our data will likely be unchanged for many frames, we tell OpenGL to expect that.
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+    if (dataSize == 0) {
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return 0;
+    }
+
+    ui8* data = new ui8[dataSize];
+    m_batcher->buildAllSprites(m_spritePtrs, m_textureIndices, data);
+
+    glBufferData(GL_ARRAY_BUFFER, dataSize, data, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    delete[] data;
+
+    return dataSize;
+}
+
+size_t spg::SpriteLayer::uploadRange(ui32 begin, ui32 end) {
+    const size_t spriteBytes = m_batcher->getSpriteBytes();
+    const size_t dataSize    = spriteBytes * (end - begin);
+
+    // Build just the sprites in the range, into their own buffer.
+    m_rangeData.resize(dataSize);
+
+    m_batcher->buildSprites(m_spritePtrs.data() + begin, m_textureIndices.data() + begin, m_rangeData.data(), end - begin);
+
+    // Overwrite the sprites where they sit in our buffer.
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(spriteBytes * begin), static_cast<GLsizeiptr>(dataSize), m_rangeData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return dataSize;
+}
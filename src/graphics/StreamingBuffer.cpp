@@ -0,0 +1,166 @@
+#include "stdafx.h"
+#include "graphics/StreamingBuffer.h"
+
+// How long, in nanoseconds, to wait on a fence before checking again.
+#define FENCE_WAIT_TIMEOUT 1000000
+
+spg::StreamingBuffer::StreamingBuffer() :
+    m_id(0),
+    m_target(GL_ARRAY_BUFFER),
+    m_persistent(false),
+    m_mapped(nullptr),
+    m_sectionSize(0),
+    m_sectionCount(0),
+    m_currentSection(0)
+{
+    /* Empty */
+}
+
+void spg::StreamingBuffer::init(GLenum target, ui32 sectionCount /*= DEFAULT_STREAMING_SECTIONS*/) {
+    m_target         = target;
+    m_sectionCount   = sectionCount;
+    m_currentSection = sectionCount - 1;
+
+    // We only need to know if persistent mapping is possible once.
+    m_persistent = GLEW_ARB_buffer_storage;
+
+    m_fences.resize(m_sectionCount, nullptr);
+}
+
+void spg::StreamingBuffer::dispose() {
+    // Delete any fences still outstanding - we don't care if the GPU has finished with them.
+    for (auto& fence : m_fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    std::vector<GLsync>().swap(m_fences);
+
+    if (m_id != 0) {
+        // Persistently mapped buffers must be unmapped before deletion.
+        if (m_mapped != nullptr) {
+            glBindBuffer(m_target, m_id);
+            glUnmapBuffer(m_target);
+            glBindBuffer(m_target, 0);
+            m_mapped = nullptr;
+        }
+
+        glDeleteBuffers(1, &m_id);
+        m_id = 0;
+    }
+
+    m_sectionSize    = 0;
+    m_sectionCount   = 0;
+    m_currentSection = 0;
+}
+
+void* spg::StreamingBuffer::map(size_t size, bool& recreated) {
+    recreated = false;
+
+    // If our sections can't hold the data we want to write, we need a new buffer.
+    if (size > m_sectionSize) {
+        if (!create(size)) return nullptr;
+
+        recreated = true;
+    }
+
+    // Move on to the next section, making sure the GPU is done reading from it.
+    m_currentSection = (m_currentSection + 1) % m_sectionCount;
+    wait(m_currentSection);
+
+    // A persistently mapped buffer just needs us to give out the right address.
+    if (m_persistent) return m_mapped + getCurrentOffset();
+
+    // Otherwise map just this section. We know the GPU is done with it thanks to the fence,
+    // so we can tell the driver not to synchronise for us.
+    glBindBuffer(m_target, m_id);
+    void* section = glMapBufferRange(m_target, getCurrentOffset(), m_sectionSize,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(m_target, 0);
+
+    return section;
+}
+
+void spg::StreamingBuffer::unmap() {
+    // Persistent, coherent mappings don't need any further work to make writes visible.
+    if (m_persistent || m_id == 0) return;
+
+    glBindBuffer(m_target, m_id);
+    glUnmapBuffer(m_target);
+    glBindBuffer(m_target, 0);
+}
+
+void spg::StreamingBuffer::fence() {
+    if (m_id == 0) return;
+
+    // Replace any fence already guarding this section - i.e. if we drew from it more than once.
+    GLsync& fence = m_fences[m_currentSection];
+    if (fence != nullptr) glDeleteSync(fence);
+
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool spg::StreamingBuffer::create(size_t sectionSize) {
+    // Grow geometrically so that a slowly climbing size doesn't recreate the buffer every frame.
+    //     Note that doubling keeps the section size a multiple of whatever stride the caller
+    //     writes with, so offsets into the buffer stay aligned to that stride.
+    size_t newSectionSize = std::max(sectionSize, m_sectionSize * 2);
+
+    // Before we throw away the old buffer, make sure the GPU isn't still reading from it.
+    for (ui32 section = 0; section < m_sectionCount; ++section) {
+        wait(section);
+    }
+
+    if (m_id != 0) {
+        if (m_mapped != nullptr) {
+            glBindBuffer(m_target, m_id);
+            glUnmapBuffer(m_target);
+            m_mapped = nullptr;
+        }
+        glDeleteBuffers(1, &m_id);
+        m_id = 0;
+    }
+
+    m_sectionSize = newSectionSize;
+    GLsizeiptr totalSize = static_cast<GLsizeiptr>(m_sectionSize * m_sectionCount);
+
+    glGenBuffers(1, &m_id);
+    glBindBuffer(m_target, m_id);
+
+    if (m_persistent) {
+        // Create immutable storage that we can keep mapped while the GPU reads from it. Being
+        // coherent, we don't need to flush our writes explicitly.
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(m_target, totalSize, nullptr, flags);
+        m_mapped = static_cast<ui8*>(glMapBufferRange(m_target, 0, totalSize, flags));
+    } else {
+        glBufferData(m_target, totalSize, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(m_target, 0);
+
+    // Start again from the beginning of the ring, next map will move us to the zeroth section.
+    m_currentSection = m_sectionCount - 1;
+
+    return !m_persistent || m_mapped != nullptr;
+}
+
+void spg::StreamingBuffer::wait(ui32 section) {
+    GLsync& fence = m_fences[section];
+    if (fence == nullptr) return;
+
+    // Wait for the GPU to signal it is done with the section. We flush on the first wait
+    // only, as otherwise the fence may never be submitted to the GPU.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        GLenum result = glClientWaitSync(fence, flags, FENCE_WAIT_TIMEOUT);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED
+                || result == GL_WAIT_FAILED) break;
+
+        flags = 0;
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
@@ -0,0 +1,252 @@
+#include "stdafx.h"
+#include "graphics/TextLayout.h"
+
+#include "graphics/StringDrawers.inl"
+
+// Marks the end of the list of entries, and empty slots of the table.
+#define NO_ENTRY 0xFFFFFFFF
+
+/**
+ * @brief Appends the bytes of the given value to the given key.
+ */
+template <typename Type>
+static void appendKey(spg::ArenaVector<ui8>& key, const Type& value) {
+    const ui8* bytes = reinterpret_cast<const ui8*>(&value);
+
+    key.insert(key.end(), bytes, bytes + sizeof(Type));
+}
+
+/**
+ * @brief Hashes the given bytes with 64-bit FNV-1a.
+ */
+static ui64 hashKey(const ui8* key, size_t size) {
+    ui64 hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= key[i];
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+void spg::TextLayout::clear() {
+    glyphs.clear();
+    lines.clear();
+
+    rect              = f32v4(0.0f);
+    size              = f32v2(0.0f);
+    firstClippedGlyph = 0;
+}
+
+spg::TextLayoutCache::TextLayoutCache() :
+    m_capacity(0),
+    m_head(NO_ENTRY), m_tail(NO_ENTRY)
+{
+    /* Empty */
+}
+
+void spg::TextLayoutCache::init(ui32 capacity /*= DEFAULT_TEXT_LAYOUT_CACHE_CAPACITY*/) {
+    m_capacity = std::max(capacity, 1u);
+
+    // Keep the table at most half full, so probes stay short.
+    ui32 slotCount = 1;
+    while (slotCount < m_capacity * 2) slotCount <<= 1;
+
+    m_slots.assign(slotCount, NO_ENTRY);
+    m_entries.reserve(m_capacity);
+
+    m_head = NO_ENTRY;
+    m_tail = NO_ENTRY;
+}
+
+void spg::TextLayoutCache::dispose() {
+    std::vector<Entry>().swap(m_entries);
+    std::vector<ui32>().swap(m_slots);
+
+    m_capacity = 0;
+    m_head     = NO_ENTRY;
+    m_tail     = NO_ENTRY;
+}
+
+void spg::TextLayoutCache::clear() {
+    std::fill(m_slots.begin(), m_slots.end(), NO_ENTRY);
+
+    // Rather than dropping the entries, we keep them for reuse. With empty keys they are in no slot of the
+    // table, and so will be taken before any entry cached after.
+    m_head = NO_ENTRY;
+    m_tail = NO_ENTRY;
+    for (ui32 i = 0; i < m_entries.size(); ++i) {
+        m_entries[i].key.clear();
+        m_entries[i].layout.clear();
+
+        linkFront(i);
+    }
+}
+
+const spg::TextLayout& spg::TextLayoutCache::fetch(        FrameArena* arena,
+                                                   const StringComponent* components,
+                                                                 size_t componentCount,
+                                                                  f32v4 rect,
+                                                              TextAlign align,
+                                                               WordWrap wrap) {
+    SP_PROFILE_ZONE("TextLayoutCache::fetch");
+
+    // Build the key in the arena, it only needs to outlive this call.
+    ArenaVector<ui8> key(arena);
+
+    appendKey(key, rect);
+    appendKey(key, align);
+    appendKey(key, wrap);
+    for (size_t c = 0; c < componentCount; ++c) {
+        const StringComponent& component = components[c];
+
+        size_t length = strlen(component.first);
+
+        appendKey(key, component.second.fontInstance.texture);
+        appendKey(key, component.second.fontInstance.height);
+        appendKey(key, component.second.fontInstance.glyphs);
+        appendKey(key, component.second.fontInstance.owner);
+        appendKey(key, component.second.fontInstance.kerning);
+        appendKey(key, component.second.sizing.kind);
+        appendKey(key, component.second.sizing.scaling);
+        appendKey(key, component.second.tint);
+        appendKey(key, length);
+        key.insert(key.end(), component.first, component.first + length);
+    }
+
+    ui64 hash = hashKey(key.data(), key.size());
+    ui32 slot = findSlot(hash, key.data(), key.size());
+
+    // If we have laid this string out before, just mark it as the most recently used.
+    if (m_slots[slot] != NO_ENTRY) {
+        ui32 index = m_slots[slot];
+
+        unlink(index);
+        linkFront(index);
+
+        return m_entries[index].layout;
+    }
+
+    // Otherwise take a new entry while we have room, or else the least recently used.
+    ui32 index;
+    if (m_entries.size() < m_capacity) {
+        index = static_cast<ui32>(m_entries.size());
+        m_entries.emplace_back();
+    } else {
+        index = m_tail;
+
+        unlink(index);
+
+        // Entries freed by clearing have no slot to erase.
+        Entry& evicted = m_entries[index];
+        if (!evicted.key.empty()) {
+            eraseSlot(findSlot(evicted.hash, evicted.key.data(), evicted.key.size()));
+
+            // Erasing may have shifted entries back, our key's slot among them.
+            slot = findSlot(hash, key.data(), key.size());
+        }
+    }
+
+    Entry& entry = m_entries[index];
+    entry.hash = hash;
+    entry.key.assign(key.begin(), key.end());
+
+    layoutStringComponents(arena, components, componentCount, rect, align, wrap, entry.layout);
+
+    m_slots[slot] = index;
+    linkFront(index);
+
+    return entry.layout;
+}
+
+ui32 spg::TextLayoutCache::findSlot(ui64 hash, const ui8* key, size_t keySize) const {
+    ui32 mask = static_cast<ui32>(m_slots.size()) - 1;
+
+    // Linear probing, until we find either our entry or a gap where it would be.
+    ui32 slot = static_cast<ui32>(hash) & mask;
+    while (m_slots[slot] != NO_ENTRY) {
+        const Entry& entry = m_entries[m_slots[slot]];
+        if (entry.hash == hash && entry.key.size() == keySize
+                && memcmp(entry.key.data(), key, keySize) == 0) break;
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+void spg::TextLayoutCache::eraseSlot(ui32 slot) {
+    ui32 mask = static_cast<ui32>(m_slots.size()) - 1;
+
+    m_slots[slot] = NO_ENTRY;
+
+    // Any entry after the gap that probed past it must move back into it, or it would no longer be found.
+    ui32 next = (slot + 1) & mask;
+    while (m_slots[next] != NO_ENTRY) {
+        ui32 home = static_cast<ui32>(m_entries[m_slots[next]].hash) & mask;
+
+        // The entry may fill the gap unless its home lies cyclically within (slot, next].
+        bool movable = slot <= next ? (home <= slot || home > next) : (home <= slot && home > next);
+        if (movable) {
+            m_slots[slot] = m_slots[next];
+            m_slots[next] = NO_ENTRY;
+            slot = next;
+        }
+
+        next = (next + 1) & mask;
+    }
+}
+
+void spg::TextLayoutCache::unlink(ui32 entry) {
+    Entry& e = m_entries[entry];
+
+    if (e.previous != NO_ENTRY) {
+        m_entries[e.previous].next = e.next;
+    } else if (m_head == entry) {
+        m_head = e.next;
+    }
+
+    if (e.next != NO_ENTRY) {
+        m_entries[e.next].previous = e.previous;
+    } else if (m_tail == entry) {
+        m_tail = e.previous;
+    }
+
+    e.previous = NO_ENTRY;
+    e.next     = NO_ENTRY;
+}
+
+void spg::TextLayoutCache::linkFront(ui32 entry) {
+    Entry& e = m_entries[entry];
+
+    e.previous = NO_ENTRY;
+    e.next     = m_head;
+
+    if (m_head != NO_ENTRY) m_entries[m_head].previous = entry;
+    m_head = entry;
+
+    if (m_tail == NO_ENTRY) m_tail = entry;
+}
+
+void spg::layoutStringComponents(        FrameArena* arena,
+                                 const StringComponent* components,
+                                               size_t componentCount,
+                                                f32v4 rect,
+                                            TextAlign align,
+                                             WordWrap wrap,
+                                           TextLayout& layout) {
+    switch(wrap) {
+        case WordWrap::NONE:
+            layoutNoWrapString(arena, components, componentCount, rect, align, layout);
+            break;
+        case WordWrap::QUICK:
+            layoutQuickWrapString(arena, components, componentCount, rect, align, layout);
+            break;
+        case WordWrap::GREEDY:
+            layoutGreedyWrapString(arena, components, componentCount, rect, align, layout);
+            break;
+        case WordWrap::MINIMUM_RAGGEDNESS:
+            layoutMinRagWrapString(arena, components, componentCount, rect, align, layout);
+            break;
+    }
+}
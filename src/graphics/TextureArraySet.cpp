@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "graphics/TextureArraySet.h"
+
+spg::TextureArraySet::TextureArraySet() :
+    m_maxLayers(0)
+{
+    /* Empty */
+}
+
+void spg::TextureArraySet::dispose() {
+    for (auto& textureArray : m_arrays) {
+        glDeleteTextures(1, &textureArray.id);
+    }
+
+    std::vector<TextureArray>().swap(m_arrays);
+    std::unordered_map<GLuint, TextureSlot>().swap(m_slots);
+    std::vector<ui8>().swap(m_pixels);
+
+    m_maxLayers = 0;
+}
+
+bool spg::TextureArraySet::add(GLuint texture) {
+    if (texture == 0) return false;
+
+    if (m_slots.count(texture) != 0) return true;
+
+    if (m_maxLayers == 0) {
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &m_maxLayers);
+    }
+
+    // Get the size of the texture, as only textures of the same size can share an array.
+    GLint width, height;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH,  &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (width == 0 || height == 0) return false;
+
+    // Find an array of this size with room for another layer.
+    ui32 arrayIndex = static_cast<ui32>(m_arrays.size());
+    for (ui32 i = 0; i < m_arrays.size(); ++i) {
+        const TextureArray& candidate = m_arrays[i];
+        if (candidate.width == width && candidate.height == height
+                && candidate.layers.size() < static_cast<size_t>(m_maxLayers)) {
+            arrayIndex = i;
+            break;
+        }
+    }
+
+    // If we have no such array, make one.
+    if (arrayIndex == m_arrays.size()) {
+        m_arrays.emplace_back(TextureArray{ 0, width, height, 0, std::vector<GLuint>() });
+    }
+    TextureArray& textureArray = m_arrays[arrayIndex];
+
+    // Grow the array if it is full - this copies each layer again, but doubling keeps the
+    // number of times we do so down.
+    ui32 layer = static_cast<ui32>(textureArray.layers.size());
+    if (layer == textureArray.capacity) {
+        ui32 capacity = std::max(INITIAL_TEXTURE_ARRAY_LAYERS, textureArray.capacity * 2);
+        create(textureArray, std::min(capacity, static_cast<ui32>(m_maxLayers)));
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.id);
+    copy(textureArray, texture, layer);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    textureArray.layers.emplace_back(texture);
+    m_slots[texture] = TextureSlot{ arrayIndex, static_cast<i32>(layer) };
+
+    return true;
+}
+
+void spg::TextureArraySet::create(TextureArray& textureArray, ui32 capacity) {
+    textureArray.capacity = capacity;
+
+    // When growing, we respecify the storage of the texture we already have rather than making a new one, so
+    // that its ID stays the same - retained layers have already batched sprites against it.
+    bool growing = textureArray.id != 0;
+    if (!growing) glGenTextures(1, &textureArray.id);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.id);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, textureArray.width, textureArray.height,
+                    static_cast<GLsizei>(capacity), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    // Match the texture parameters we use for our font textures. These belong to the texture, so survive growing.
+    if (!growing) {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,     GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,     GL_REPEAT);
+    }
+
+    // Respecifying discards the old contents, so copy back in any layers we already had from their 2D textures.
+    for (ui32 layer = 0; layer < textureArray.layers.size(); ++layer) {
+        copy(textureArray, textureArray.layers[layer], layer);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void spg::TextureArraySet::copy(const TextureArray& textureArray, GLuint texture, ui32 layer) {
+    m_pixels.resize(static_cast<size_t>(textureArray.width) * static_cast<size_t>(textureArray.height) * 4);
+
+    // Read the texture back and upload it into the layer.
+    //     Copying directly between textures needs GL 4.3, so we go via the CPU.
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer), textureArray.width, textureArray.height, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, m_pixels.data());
+}
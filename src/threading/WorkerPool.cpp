@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "threading/WorkerPool.h"
+
+spthread::WorkerPool::WorkerPool() :
+    m_quit(false),
+    m_generation(0),
+    m_activeWorkers(0),
+    m_task(nullptr),
+    m_count(0), m_chunkSize(0), m_chunkCount(0),
+    m_nextChunk(0)
+{
+    /* Empty */
+}
+
+void spthread::WorkerPool::init(ui32 workerCount /*= 0*/) {
+    if (!m_workers.empty()) return;
+
+    // By default, leave one hardware thread for the thread submitting work.
+    if (workerCount == 0) {
+        ui32 hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    m_quit = false;
+
+    m_workers.reserve(workerCount);
+    for (ui32 i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+void spthread::WorkerPool::dispose() {
+    if (m_workers.empty()) return;
+
+    // Tell the workers to quit, and wake them so they notice.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+
+    std::vector<std::thread>().swap(m_workers);
+}
+
+void spthread::WorkerPool::parallelFor(size_t count, size_t chunkSize, const RangeTask& task) {
+    if (count == 0) return;
+    if (chunkSize == 0) chunkSize = count;
+
+    // If we have no workers, or only enough work for one chunk, just do it here.
+    if (m_workers.empty() || count <= chunkSize) {
+        task(0, count);
+        return;
+    }
+
+    // Set up the job. We wait for any workers still finishing up with the last job, so
+    // that none of them can see the job change underneath them.
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_activeWorkers == 0; });
+
+        m_task       = &task;
+        m_count      = count;
+        m_chunkSize  = chunkSize;
+        m_chunkCount = (count + chunkSize - 1) / chunkSize;
+        m_nextChunk.store(0);
+
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    // Muck in with the workers.
+    runChunks();
+
+    // Once we are out of chunks, the only work left is with the workers - wait for them.
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_activeWorkers == 0; });
+
+        m_task = nullptr;
+    }
+}
+
+void spthread::WorkerPool::workerLoop() {
+    ui64 seenGeneration = 0;
+
+    while (true) {
+        // Sleep until there is a job we haven't yet seen, or we are told to quit.
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_quit || m_generation != seenGeneration; });
+
+            if (m_quit) return;
+
+            seenGeneration = m_generation;
+            ++m_activeWorkers;
+        }
+
+        runChunks();
+
+        // Let the submitting thread know if we were the last worker still busy.
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_activeWorkers;
+        }
+        m_done.notify_all();
+    }
+}
+
+void spthread::WorkerPool::runChunks() {
+    while (true) {
+        size_t chunk = m_nextChunk.fetch_add(1);
+        if (chunk >= m_chunkCount) return;
+
+        size_t begin = chunk * m_chunkSize;
+        size_t end   = std::min(begin + m_chunkSize, m_count);
+
+        (*m_task)(begin, end);
+    }
+}